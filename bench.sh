@@ -0,0 +1 @@
+g++ benchmark.cpp -O3 -march=native -DNDEBUG -Wall -Werror -pthread -o benchmark && ./benchmark "$@"
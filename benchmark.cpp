@@ -0,0 +1,382 @@
+// Benchmarks the main DataFrame paths on a synthetic CSV file.
+//
+// Usage: ./benchmark [--rows N] [--int-cols N] [--float-cols N] [--str-cols N]
+//                    [--distinct N] [--missing P] [--repeat N] [--threads N] [--file PATH]
+//
+// The file is generated (deterministically, from a fixed seed) unless --file names an
+// existing CSV. Each benchmark prints one JSON object per line with the best time of
+// --repeat runs, its throughput and the peak resident set size so far, e.g.
+//   {"name":"load_csv","rows":1000000,"bytes":48213345,"seconds":0.21,"rows_per_s":4.7e+06,"mb_per_s":229,"peak_rss_mb":96}
+
+#include "lesser_pandas.h"
+#include <chrono>
+#include <random>
+#include <sys/resource.h>
+
+struct BenchConfig {
+    size_t rows = 1000000;
+    size_t int_cols = 2;
+    size_t float_cols = 2;
+    size_t str_cols = 2;
+    size_t distinct = 100; // distinct values per string column
+    double missing = 0.05; // fraction of empty fields
+    size_t repeat = 3;
+    size_t threads = 0; // threads of the library's pool, used by every benchmark (0 = hardware concurrency)
+    string file;
+};
+
+static double peak_rss_mb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+}
+
+/**
+ * @brief Writes a CSV file with the configured shape and returns its size in bytes.
+ */
+static size_t generate_csv(const BenchConfig& config, const string& path) {
+    mt19937_64 rng(42);
+    uniform_int_distribution<int64_t> ints(-1000000, 1000000);
+    uniform_real_distribution<double> floats(-1000.0, 1000.0);
+    uniform_int_distribution<size_t> categories(0, config.distinct - 1);
+    bernoulli_distribution missing(config.missing);
+
+    ofstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("Error: Unable to open file for writing!");
+    }
+    string line;
+    for (size_t c = 0; c < config.int_cols; c++) {
+        line += "i" + to_string(c) + ",";
+    }
+    for (size_t c = 0; c < config.float_cols; c++) {
+        line += "f" + to_string(c) + ",";
+    }
+    for (size_t c = 0; c < config.str_cols; c++) {
+        line += "s" + to_string(c) + ",";
+    }
+    line.back() = '\n';
+    file << line;
+
+    char buf[32];
+    for (size_t row = 0; row < config.rows; row++) {
+        line.clear();
+        for (size_t c = 0; c < config.int_cols; c++) {
+            if (!missing(rng)) {
+                line.append(buf, to_chars(buf, buf + sizeof(buf), ints(rng)).ptr);
+            }
+            line += ',';
+        }
+        for (size_t c = 0; c < config.float_cols; c++) {
+            if (!missing(rng)) {
+                line.append(buf, snprintf(buf, sizeof(buf), "%.3f", floats(rng)));
+            }
+            line += ',';
+        }
+        for (size_t c = 0; c < config.str_cols; c++) {
+            if (!missing(rng)) {
+                line += "cat_" + to_string(categories(rng));
+            }
+            line += ',';
+        }
+        line.back() = '\n';
+        file << line;
+    }
+    file.close();
+    return std::filesystem::file_size(path);
+}
+
+static void report(const string& name, size_t rows, size_t bytes, double seconds) {
+    cout << "{\"name\":\"" << name << "\",\"rows\":" << rows << ",\"bytes\":" << bytes
+         << ",\"seconds\":" << seconds << ",\"rows_per_s\":" << rows / seconds
+         << ",\"mb_per_s\":" << bytes / seconds / 1e6 << ",\"peak_rss_mb\":" << peak_rss_mb() << "}" << endl;
+}
+
+/**
+ * @brief Runs f config.repeat times and returns the best time in seconds.
+ *
+ * @param setup Called before every run, outside the timed region
+ */
+template <typename Setup, typename F>
+static double best_time(const BenchConfig& config, Setup&& setup, F&& f) {
+    double best = numeric_limits<double>::infinity();
+    for (size_t run = 0; run < std::max<size_t>(1, config.repeat); run++) {
+        setup();
+        // the library reports some operations on cout; keep stdout machine-readable
+        ostringstream discard;
+        streambuf* saved = cout.rdbuf(discard.rdbuf());
+        auto start = chrono::steady_clock::now();
+        f();
+        auto stop = chrono::steady_clock::now();
+        cout.rdbuf(saved);
+        best = std::min(best, chrono::duration<double>(stop - start).count());
+    }
+    return best;
+}
+
+/**
+ * @brief Times f (see best_time()) and prints the result as one JSON line.
+ */
+template <typename Setup, typename F>
+static void bench(const BenchConfig& config, const string& name, size_t rows, size_t bytes, Setup&& setup, F&& f) {
+    report(name, rows, bytes, best_time(config, setup, f));
+}
+
+template <typename F>
+static void bench(const BenchConfig& config, const string& name, size_t rows, size_t bytes, F&& f) {
+    bench(config, name, rows, bytes, [] {}, f);
+}
+
+static BenchConfig parse_args(int argc, char** argv) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("Invalid argument: " + arg + " expects a value");
+        }
+        string value = argv[++i];
+        if (arg == "--rows") {
+            config.rows = stoull(value);
+        } else if (arg == "--int-cols") {
+            config.int_cols = stoull(value);
+        } else if (arg == "--float-cols") {
+            config.float_cols = stoull(value);
+        } else if (arg == "--str-cols") {
+            config.str_cols = stoull(value);
+        } else if (arg == "--distinct") {
+            config.distinct = std::max<size_t>(1, stoull(value));
+        } else if (arg == "--missing") {
+            config.missing = stod(value);
+        } else if (arg == "--repeat") {
+            config.repeat = stoull(value);
+        } else if (arg == "--threads") {
+            config.threads = stoull(value);
+        } else if (arg == "--file") {
+            config.file = value;
+        } else {
+            throw invalid_argument("Invalid argument: unknown option " + arg);
+        }
+    }
+    if (config.int_cols + config.float_cols == 0) {
+        throw invalid_argument("Invalid argument: the benchmarks need at least one int or float column");
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    try {
+        config = parse_args(argc, argv);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    string path = config.file;
+    if (path.empty() || !std::filesystem::exists(path)) {
+        if (path.empty()) {
+            path = (std::filesystem::temp_directory_path() / "lesser_pandas_bench.csv").string();
+        }
+        generate_csv(config, path);
+    }
+    size_t file_bytes = std::filesystem::file_size(path);
+
+    ThreadPool::configure(config.threads);
+    CsvOptions options;
+    options.num_threads = 0;
+    DataFrame df;
+    double load_seconds = best_time(config, [] {}, [&] {
+        df = DataFrame(path, options);
+    });
+    size_t n = df.num_rows();
+    report("load_csv", n, file_bytes, load_seconds);
+
+    // bytes of column data the whole-frame benchmarks touch
+    auto text_bytes = [&](const Column& col) {
+        size_t bytes = 0;
+        for (size_t row = 0; row < n; row++) {
+            bytes += col.str_at(row).size();
+        }
+        return bytes;
+    };
+    size_t data_bytes = 0;
+    for (const string& name : df.columns) {
+        const Column& col = df[name];
+        data_bytes += col.dtype == "string" ? text_bytes(col) : n * 8;
+    }
+
+    // a numeric column to compare, reduce and filter on, and the first string column if any
+    string num_name;
+    string str_name;
+    for (const string& name : df.columns) {
+        const string& dtype = df[name].dtype;
+        if (num_name.empty() && dtype != "string") {
+            num_name = name;
+        }
+        if (str_name.empty() && dtype == "string") {
+            str_name = name;
+        }
+    }
+    if (num_name.empty()) {
+        cerr << "Invalid argument: the benchmarks need at least one int or float column" << endl;
+        return 1;
+    }
+    Column& num = df[num_name];
+    size_t num_bytes = n * 8;
+    double threshold = num.mean();
+
+    Bitmap mask;
+    bench(config, "compare_gt", n, num_bytes, [&] {
+        mask = num > threshold;
+    });
+    if (!str_name.empty()) {
+        Column& str = df[str_name];
+        string key = str.str_at(0).empty() ? "cat_0" : string(str.str_at(0));
+        bench(config, "compare_eq_string", n, text_bytes(str), [&] {
+            mask = str == key;
+        });
+    }
+
+    // a selective range query on the same values in ascending order, where the zone map
+    // (built by the first, untimed, comparison) leaves only the boundary blocks to scan
+    DataFrame sorted = df.sort_values({num_name});
+    Column& sorted_num = sorted[num_name];
+    double high = num.max() - (num.max() - num.min()) / 100;
+    mask = sorted_num > high;
+    bench(config, "compare_gt_sorted", n, num_bytes, [&] {
+        mask = sorted_num > high;
+    });
+
+    // both filters keep the rows above the mean
+    mask = num > threshold;
+    vector<bool> bool_mask(n);
+    for (size_t row = 0; row < n; row++) {
+        bool_mask[row] = mask.get(row);
+    }
+    DataFrame filtered;
+    bench(config, "filter_vector_bool", n, data_bytes, [&] {
+        filtered = df[bool_mask];
+    });
+    bench(config, "filter_bitmap", n, data_bytes, [&] {
+        filtered = df[mask];
+    });
+
+    // the reductions cache their results in the column's buffers, so each run gets a
+    // fresh copy of the buffers; mean_cached times the cached answer
+    vector<size_t> all_rows(n);
+    for (size_t row = 0; row < n; row++) {
+        all_rows[row] = row;
+    }
+    Column fresh;
+    auto refresh = [&] {
+        fresh = num.take(all_rows);
+    };
+    double sink = 0;
+    bench(config, "mean", n, num_bytes, refresh, [&] {
+        sink += fresh.mean();
+    });
+    bench(config, "mean_cached", n, num_bytes, [&] {
+        sink += num.mean();
+    });
+    bench(config, "min", n, num_bytes, refresh, [&] {
+        sink += fresh.min();
+    });
+    bench(config, "max", n, num_bytes, refresh, [&] {
+        sink += fresh.max();
+    });
+    // reductions nested in a parallel loop over the same columns: a thread waiting for its
+    // reduction helps with the outer tasks, which reduce the same buffers, so this also
+    // checks that the pool cannot deadlock on the statistics cache
+    vector<Column> nested(4);
+    bench(config, "nested_reduce", n * nested.size(), num_bytes * nested.size(), [&] {
+        for (Column& col : nested) {
+            col = num.take(all_rows);
+        }
+    }, [&] {
+        vector<double> out(256);
+        parallel_for(out.size(), 0, [&](size_t i) {
+            if (i % 3 == 0) {
+                out[i] = nested[i % nested.size()].std();
+            } else {
+                // short outer tasks keep the loop busy while the reductions wait
+                double x = 0;
+                for (size_t k = 0; k < 20000; k++) {
+                    x += sqrt(static_cast<double>(k));
+                }
+                out[i] = x;
+            }
+        });
+        sink += out[0];
+    });
+    bench(config, "quantile", n, num_bytes, [&] {
+        sink += num.quantile({0.5, 0.99})[1];
+    });
+    bench(config, "nunique", n, num_bytes, [&] {
+        sink += num.nunique();
+    });
+    bench(config, "nunique_approx", n, num_bytes, [&] {
+        sink += num.nunique_approx();
+    });
+    if (!str_name.empty()) {
+        Column& str = df[str_name];
+        bench(config, "value_counts_string", n, text_bytes(str), [&] {
+            sink += str.value_counts().num_rows();
+        });
+    }
+
+    // a second numeric column for the element-wise benchmarks, or the same one again
+    string other_name = num_name;
+    for (const string& name : df.columns) {
+        if (name != num_name && df[name].dtype != "string") {
+            other_name = name;
+            break;
+        }
+    }
+    Column& other = df[other_name];
+    Column derived;
+    bench(config, "add_columns", n, num_bytes * 2, [&] {
+        derived = num + other;
+    });
+    // (a * b + a) / b as a chain of Column operators, then fused by eval()
+    bench(config, "arith_chain", n, num_bytes * 2, [&] {
+        derived = (num * other + num) / other;
+    });
+    Expr a = Expr::col(num_name);
+    Expr b = Expr::col(other_name);
+    bench(config, "arith_eval", n, num_bytes * 2, [&] {
+        derived = df.eval((a * b + a) / b);
+    });
+
+    DataFrame work;
+    bench(config, "dropna", n, data_bytes, [&] {
+        work = df;
+    }, [&] {
+        work.dropna(num_name);
+    });
+    bench(config, "fillna", n, data_bytes, [&] {
+        work = df;
+    }, [&] {
+        work.fillna(0);
+    });
+
+    // head() formats through the same path as print() and operator<<; a bounded number
+    // of rows keeps the discarded output (buffered in memory) out of the peak RSS
+    size_t print_rows = std::min<size_t>(n, 1 << 16);
+    bench(config, "print", print_rows, n ? file_bytes / n * print_rows : 0, [&] {
+        df.head(static_cast<int>(print_rows));
+    });
+
+    string out_path = path + ".out.csv";
+    bench(config, "save_to_csv", n, file_bytes, [&] {
+        df.save_to_csv(out_path, false);
+    });
+    std::filesystem::remove(out_path);
+
+    // keeps the reductions from being optimized away
+    cerr << "checksum " << sink << endl;
+    return 0;
+}
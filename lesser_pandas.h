@@ -28,993 +28,9001 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <array>
 #include <string>
 #include <stdexcept>
 #include <map>
+#include <unordered_map>
 #include <iomanip>
 #include <algorithm>
 #include <type_traits>
+#include <functional>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include <string_view>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(LESSER_PANDAS_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(LESSER_PANDAS_ZSTD)
+#include <zstd.h>
+#endif
 using namespace std;
 
 /**
- * @brief Represents a single column in a DataFrame with associated operations.
- * 
- * The Column class stores data as strings internally but can handle different data types
- * (int, float, string) through automatic type detection and conversion. It provides
- * statistical operations, filtering, and data manipulation methods.
+ * @brief Formats a floating-point value using the shortest round-trip representation.
+ *
+ * @param x The value to format
+ * @return The formatted string (e.g. "50000.5", "62000")
  */
-class Column {
-public:
-    string name; // column's name
-    vector<string> data; // column's data
-    string dtype = "string"; // data type
-    friend std::ostream& operator<<(std::ostream& os, const Column& col);
+inline string format_float(double x) {
+    char buf[32];
+    auto res = to_chars(buf, buf + sizeof(buf), x);
+    return string(buf, res.ptr);
+}
 
-    /**
-     * @brief Prints the column data with optional row limiting and tail functionality.
-     * 
-     * @param rows_cnt Number of rows to print (0 = print all rows)
-     * @param is_tail If true, prints the last N rows instead of first N rows
-     */
-    void print(int rows_cnt = 0, bool is_tail = false) const {
-        if (data.size() == 0) {
-            return;
+/**
+ * @brief Parses a string as a 64-bit integer without allocating or throwing.
+ *
+ * @param s The text to parse (an optional leading '+' is accepted)
+ * @param out Receives the parsed value
+ * @return True if the whole text was a valid integer in range, false otherwise
+ */
+inline bool parse_int(string_view s, int64_t& out) {
+    const char* first = s.data();
+    const char* last = s.data() + s.size();
+    if (first != last && *first == '+') {
+        first++;
+        if (first != last && *first == '-') {
+            return false;
         }
+    }
+    auto res = from_chars(first, last, out);
+    return first != last && res.ec == errc() && res.ptr == last;
+}
 
-        if (rows_cnt == 0) {
-            rows_cnt = data.size()-1;
+/**
+ * @brief Parses a string as a double without allocating or throwing.
+ *
+ * @param s The text to parse (an optional leading '+' is accepted)
+ * @param out Receives the parsed value
+ * @return True if the whole text was a valid floating-point number, false otherwise
+ */
+inline bool parse_float(string_view s, double& out) {
+    const char* first = s.data();
+    const char* last = s.data() + s.size();
+    if (first != last && *first == '+') {
+        first++;
+        if (first != last && *first == '-') {
+            return false;
         }
+    }
+    auto res = from_chars(first, last, out);
+    return first != last && res.ec == errc() && res.ptr == last;
+}
 
-        cout << name << endl;
-
-        for(size_t i = 0; i < name.length(); i++) {
-            cout << '-';
-        }
+/**
+ * @brief Checks if a string represents a valid integer.
+ *
+ * @param s The string to test
+ * @return True if the string can be converted to an integer, false otherwise
+ */
+inline bool is_integer(string_view s) {
+    int64_t value;
+    return parse_int(s, value);
+}
 
-        cout << endl;
+/**
+ * @brief Checks if a string represents a valid floating-point number.
+ *
+ * @param s The string to test
+ * @return True if the string can be converted to a double, false otherwise
+ */
+inline bool is_float(string_view s) {
+    double value;
+    return parse_float(s, value);
+}
 
-        if (is_tail) {
-            for(size_t idx = data.size()-rows_cnt; idx < data.size(); idx++) {
-                cout << data[idx] << endl;
-            }
-        } else {
-            for(int idx = 0; idx < rows_cnt; idx++) {
-                cout << data[idx] << endl;
-            }
-        }
+/**
+ * @brief Totals of one kind of operation, as recorded by the profiling hooks; see Profiler.
+ */
+struct OperationProfile {
+    size_t calls = 0;
+    double seconds = 0; // wall time, including the operations it called
+    size_t rows = 0; // rows read or produced
+    size_t bytes = 0; // input bytes processed
+    size_t allocations = 0; // column buffers allocated or copied on write while it ran
+    size_t peak_memory = 0; // largest column footprint (see Column::memory_usage()) of a result
+};
 
-        cout << "\nPrinted: " << rows_cnt << " rows\n";
+/**
+ * @brief Per-operation timings and counters of the library's hot paths.
+ *
+ * The hooks are compiled in only when LESSER_PANDAS_PROFILE is defined before the header
+ * is included; otherwise they expand to nothing and stats() stays empty. Parsing, dtype
+ * inference, comparisons, filtering, sorting, joins, aggregation and the CSV and binary
+ * readers and writers are recorded under their own names, e.g. "read_csv",
+ * "csv.infer_dtypes", "filter" or "save_to_csv".
+ *
+ * Allocations are counted process-wide, so operations running at the same time on
+ * different threads see each other's.
+ */
+class Profiler {
+public:
+    /**
+     * @brief Returns whether the profiling hooks are compiled in.
+     */
+    static constexpr bool enabled() {
+#if defined(LESSER_PANDAS_PROFILE)
+        return true;
+#else
+        return false;
+#endif
     }
 
     /**
-     * @brief Displays the first N rows of the column.
-     * 
-     * @param rows_cnt Number of rows to display from the beginning (default: 5)
+     * @brief Returns the totals of every operation recorded since the last reset().
      */
-    void head(int rows_cnt = 5) const {
-        print(rows_cnt);
+    static map<string, OperationProfile> stats() {
+        State& state = instance();
+        lock_guard<mutex> guard(state.lock);
+        return state.totals;
     }
 
     /**
-     * @brief Displays the last N rows of the column.
-     * 
-     * @param rows_cnt Number of rows to display from the end (default: 5)
+     * @brief Returns the totals of one operation (all zero if it has not run).
      */
-    void tail(int rows_cnt = 5) const {
-        print(rows_cnt, true);
+    static OperationProfile get(const string& name) {
+        State& state = instance();
+        lock_guard<mutex> guard(state.lock);
+        auto it = state.totals.find(name);
+        return it == state.totals.end() ? OperationProfile() : it->second;
     }
 
     /**
-     * @brief Calculates the arithmetic mean of numeric column data.
-     * 
-     * @return The mean value as a double
-     * @throws invalid_argument If the column dtype is not "int" or "float"
-     * @note Empty/missing values are excluded from the calculation
+     * @brief Clears the totals and the recorded trace.
      */
-    double mean() const {
-        if (dtype == "int" || dtype == "float") {
-            double sum = 0;
-            double col_size = static_cast<double> (data.size());
-            for(const string& element : data) {
-                if (element.length() == 0) {
-                    // missing element
-                    col_size--;
-                    continue;
-                }
-                double num = stod(element);
-                sum += num;
-            }
-            return sum / col_size;
-        }
+    static void reset() {
+        State& state = instance();
+        lock_guard<mutex> guard(state.lock);
+        state.totals.clear();
+        state.events.clear();
+    }
 
-        throw invalid_argument("Invalid type: Column::mean() expects `dtype` to be int or float");
+    /**
+     * @brief Starts or stops keeping every call for chrome_trace() (off by default).
+     */
+    static void trace(bool on = true) {
+        instance().tracing = on;
     }
 
     /**
-     * @brief Calculates the sum of the column data.
-     * 
-     * @return The sum value as a double
-     * @throws invalid_argument If the column dtype is not "int" or "float"
-     * @note Empty/missing values are excluded from the calculation
+     * @brief Returns the calls recorded while tracing, in the Chrome trace event format.
+     *
+     * @return A JSON object that chrome://tracing and Perfetto load; each call is a
+     *         complete ("X") event on the thread that ran it, with its rows and bytes as args
      */
-    double sum() const {
-        if (dtype == "int" || dtype == "float") {
-            double sum = 0;
-            for(const string& element : data) {
-                if (element.length() == 0) {
-                    // missing element
-                    continue;
-                }
-                double num = stod(element);
-                sum += num;
-            }
-            return sum;
+    static string chrome_trace() {
+        State& state = instance();
+        lock_guard<mutex> guard(state.lock);
+        string out = "{\"traceEvents\":[";
+        char buf[64];
+        for (size_t idx = 0; idx < state.events.size(); idx++) {
+            const Event& event = state.events[idx];
+            out += idx == 0 ? "\n" : ",\n";
+            out += "{\"name\":\"";
+            out += event.name;
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + to_string(event.thread);
+            out.append(buf, snprintf(buf, sizeof(buf), ",\"ts\":%.3f,\"dur\":%.3f", event.start_us, event.duration_us));
+            out += ",\"args\":{\"rows\":" + to_string(event.rows) + ",\"bytes\":" + to_string(event.bytes) + "}}";
         }
-
-        throw invalid_argument("Invalid type: Column::mean() expects `dtype` to be int or float");
+        out += "\n]}\n";
+        return out;
     }
-    
+
     /**
-     * @brief Returns a sorted copy of the column data in ascending order.
-     * 
-     * @return Vector of strings containing sorted numeric values
-     * @throws invalid_argument If the column dtype is "string"
-     * @note The original column data remains unchanged
+     * @brief Writes chrome_trace() to a file.
+     *
+     * @throws runtime_error If the file cannot be opened or written
      */
-    vector<string> sorted() const {
-        if (dtype == "string") {
-            throw invalid_argument("Invalid type: Column::Sorted() expects `dtype` to be int or float");
+    static void save_chrome_trace(const string& path) {
+        ofstream file(path, ios::binary);
+        file << chrome_trace();
+        if (!file) {
+            throw runtime_error("Error: Unable to write file: " + path);
         }
-        vector<string> result = data;
+    }
 
-        std::sort(result.begin(), result.end(), [](string &s1, string &s2) {
-            return stod(s1) < stod(s2);
-        });
-        
-        return result;
+private:
+    struct Event {
+        const char* name;
+        size_t thread;
+        double start_us;
+        double duration_us;
+        size_t rows;
+        size_t bytes;
+    };
+
+    struct State {
+        mutex lock;
+        map<string, OperationProfile> totals;
+        vector<Event> events;
+        atomic<bool> tracing{false};
+        atomic<size_t> allocations{0};
+        atomic<size_t> threads{0};
+        chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+    };
+
+    static State& instance() {
+        static State state;
+        return state;
+    }
+
+    friend class ProfileScope;
+};
+
+/**
+ * @brief Records the operation running until the end of the scope; see LP_PROFILE_SCOPE.
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name(name), parent(current()), start(chrono::steady_clock::now()),
+          allocations(Profiler::instance().allocations.load(memory_order_relaxed)) {
+        current() = this;
+    }
+
+    ~ProfileScope() {
+        auto stop = chrono::steady_clock::now();
+        current() = parent;
+        Profiler::State& state = Profiler::instance();
+        thread_local size_t thread = state.threads++;
+        lock_guard<mutex> guard(state.lock);
+        OperationProfile& total = state.totals[name];
+        total.calls++;
+        total.seconds += chrono::duration<double>(stop - start).count();
+        total.rows += rows;
+        total.bytes += bytes;
+        total.allocations += state.allocations.load(memory_order_relaxed) - allocations;
+        total.peak_memory = std::max(total.peak_memory, memory);
+        if (state.tracing) {
+            state.events.push_back({
+                name, thread, chrono::duration<double, micro>(start - state.epoch).count(),
+                chrono::duration<double, micro>(stop - start).count(), rows, bytes
+            });
+        }
     }
 
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
     /**
-     * @brief Finds the minimum value in the column.
-     * 
-     * @return The minimum value as a double
-     * @throws invalid_argument If the column dtype is "string"
+     * @brief The innermost scope open on the calling thread, or null.
      */
-    double min() {
-        if (dtype == "string") {
-            throw invalid_argument("Invalid type: Column::min() expects `dtype` to be int or float");
-        }
-        vector<string> sorted_col = sorted();
-        double mn = stod(sorted_col[0]);
+    static ProfileScope*& current() {
+        thread_local ProfileScope* scope = nullptr;
+        return scope;
+    }
 
-        return mn;
+    static void count_allocation() {
+        Profiler::instance().allocations.fetch_add(1, memory_order_relaxed);
     }
 
+    size_t rows = 0;
+    size_t bytes = 0;
+    size_t memory = 0;
+
+private:
+    const char* name;
+    ProfileScope* parent;
+    chrono::steady_clock::time_point start;
+    size_t allocations;
+};
+
+// LP_PROFILE_SCOPE(name) times the rest of the enclosing block as operation `name`;
+// LP_PROFILE_ROWS and LP_PROFILE_MEMORY add to the innermost scope of the calling thread.
+// Without LESSER_PANDAS_PROFILE they expand to nothing and their arguments are not evaluated.
+#if defined(LESSER_PANDAS_PROFILE)
+#define LP_PROFILE_CONCAT_(a, b) a##b
+#define LP_PROFILE_CONCAT(a, b) LP_PROFILE_CONCAT_(a, b)
+#define LP_PROFILE_SCOPE(name) ProfileScope LP_PROFILE_CONCAT(lp_profile_scope_, __LINE__)(name)
+#define LP_PROFILE_ROWS(num_rows, num_bytes) \
+    do { \
+        if (ProfileScope* lp_scope_ = ProfileScope::current()) { \
+            lp_scope_->rows += (num_rows); \
+            lp_scope_->bytes += (num_bytes); \
+        } \
+    } while (0)
+#define LP_PROFILE_MEMORY(num_bytes) \
+    do { \
+        if (ProfileScope* lp_scope_ = ProfileScope::current()) { \
+            lp_scope_->memory = std::max<size_t>(lp_scope_->memory, (num_bytes)); \
+        } \
+    } while (0)
+#define LP_PROFILE_ALLOCATION() ProfileScope::count_allocation()
+#else
+#define LP_PROFILE_SCOPE(name) ((void)0)
+#define LP_PROFILE_ROWS(num_rows, num_bytes) ((void)0)
+#define LP_PROFILE_MEMORY(num_bytes) ((void)0)
+#define LP_PROFILE_ALLOCATION() ((void)0)
+#endif
+
+/**
+ * @brief Whether library operations may split their work across the thread pool.
+ */
+enum class ExecutionPolicy {
+    sequential, // every operation runs on the calling thread
+    parallel    // long operations split into tasks run by the pool (default)
+};
+
+/**
+ * @brief The library's worker threads, shared by every operation in the process.
+ *
+ * parallel_for() publishes its tasks (morsels: a range of rows, a chunk of a file, a
+ * column) as a job in one job list shared by all threads; there are no per-worker
+ * queues and no stealing. Idle workers take one task at a time from the active jobs in turn,
+ * so DataFrames processed at the same time on different threads share the cores instead
+ * of each starting its own threads. The calling thread works on its own job too, and
+ * while it waits for the last tasks it helps with the other jobs, so nested parallel
+ * loops cannot deadlock the pool.
+ *
+ * Workers start on first use, with one thread per core in total (the caller included).
+ */
+class ThreadPool {
+public:
     /**
-     * @brief Finds the maximum value in the column.
-     * 
-     * @return The maximum value as a double
-     * @throws invalid_argument If the column dtype is "string"
+     * @brief Restarts the pool with a new number of threads.
+     *
+     * @param num_threads Threads available to one operation, the caller included
+     *                    (0 = hardware concurrency, 1 = no workers)
+     * @param pin_threads Whether to bind worker i to core i + 1 (Linux only)
+     * @note Must not be called while library operations are running
      */
-    double max() {
-        if (dtype == "string") {
-            throw invalid_argument("Invalid type: Column::max() expects `dtype` to be int or float");
-        }
-        vector<string> sorted_col = sorted();
-        double mx = stod(sorted_col[sorted_col.size()-1]);
+    static void configure(size_t num_threads, bool pin_threads = false) {
+        instance().restart(num_threads, pin_threads);
+    }
 
-        return mx;
+    /**
+     * @brief Sets the policy of threads that have no ExecutionScope (default: parallel).
+     */
+    static void set_policy(ExecutionPolicy policy) {
+        global_policy() = policy;
     }
 
     /**
-     * @brief Fills missing (empty) values in the column with a specified value.
-     * 
-     * @tparam T The type of the fill value (int, double, or string)
-     * @param x The value to use for filling missing entries
-     * @note For numeric types, the value is converted to string representation
+     * @brief Returns the policy in effect on the calling thread.
      */
-    template <typename T>
-    void fillna(T x) {
-        for (string &element : data) {
-            if (element.length() == 0) {
-                // missing element
-                if (is_same<T, int>::value || is_same<T, double>::value) {
-                    if (dtype == "int") {
-                        x = static_cast<int>(x);
-                    }
-                    element = to_string(x);
-                } else {
-                    element = x;
-                }
-            }
-        }
+    static ExecutionPolicy policy() {
+        int local = scoped_policy();
+        return local < 0 ? global_policy().load() : static_cast<ExecutionPolicy>(local);
     }
 
     /**
-     * @brief Equality comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements equal the key
-     * @throws runtime_error If the column dtype is "string"
+     * @brief Returns how many threads an operation started on the calling thread may use.
+     *
+     * @return 1 under the sequential policy, otherwise the configured number of threads
      */
-    vector<bool> operator==(const double& key) const {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
+    static size_t concurrency() {
+        return policy() == ExecutionPolicy::sequential ? 1 : instance().threads();
+    }
+
+    /**
+     * @brief Runs f(0), ..., f(n-1) on up to max_threads threads of the pool; see parallel_for().
+     */
+    template <typename F>
+    static void run(size_t n, size_t max_threads, F& f) {
+        auto job = make_shared<Job>();
+        job->n = n;
+        job->max_workers = max_threads;
+        job->policy = static_cast<int>(policy());
+        job->body = &f;
+        job->invoke = [](void* body, size_t i) {
+            (*static_cast<F*>(body))(i);
+        };
+        instance().execute(job);
+    }
+
+private:
+    struct Job {
+        size_t n = 0;
+        size_t max_workers = 1;
+        int policy = 0; // of the submitting thread, applied to nested operations of the tasks
+        void* body = nullptr;
+        void (*invoke)(void*, size_t) = nullptr;
+        atomic<size_t> next{0}; // first task not yet taken
+        atomic<size_t> done{0};
+        size_t workers = 0; // threads working on the job, guarded by the pool mutex
+        exception_ptr error;
+        mutex error_mutex;
+    };
+
+    mutex lock;
+    condition_variable changed; // a job was added or finished, or the pool is stopping
+    vector<shared_ptr<Job>> jobs; // jobs with tasks left (or being finished)
+    atomic<size_t> num_jobs{0}; // jobs.size(), read by workers between tasks without the mutex
+    size_t cursor = 0; // round-robin position in jobs
+    vector<thread> workers;
+    bool stopping = false;
+    bool started = false;
+    size_t total_threads = 1;
+
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    static atomic<ExecutionPolicy>& global_policy() {
+        static atomic<ExecutionPolicy> policy(ExecutionPolicy::parallel);
+        return policy;
+    }
+
+    static int& scoped_policy() {
+        thread_local int policy = -1; // -1: none, else an ExecutionPolicy
+        return policy;
+    }
+
+    friend class ExecutionScope;
+
+    ThreadPool() = default;
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    size_t threads() {
+        lock_guard<mutex> guard(lock);
+        if (!started) {
+            start(0, false);
         }
+        return total_threads;
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) == key); 
-                }
-            } catch (...) {
-                mask[i] = false; 
+    void restart(size_t num_threads, bool pin_threads) {
+        stop();
+        lock_guard<mutex> guard(lock);
+        start(num_threads, pin_threads);
+    }
+
+    // called with lock held
+    void start(size_t num_threads, bool pin_threads) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, thread::hardware_concurrency());
+        }
+        total_threads = num_threads;
+        stopping = false;
+        started = true;
+        for (size_t i = 1; i < num_threads; i++) {
+            workers.emplace_back([this] { work(); });
+#if defined(__linux__)
+            if (pin_threads) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(i % std::max(1u, thread::hardware_concurrency()), &cpus);
+                pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpus), &cpus);
             }
+#else
+            (void)pin_threads;
+#endif
         }
-        return mask;
-    } 
+    }
 
-    /**
-     * @brief Inequality comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements are not equal to the key
-     * @throws runtime_error If the column dtype is "string"
-     */
-    vector<bool> operator!=(const double& key) {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
+    void stop() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
         }
+        workers.clear();
+        lock_guard<mutex> guard(lock);
+        started = false;
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) != key); 
-                }
-            } catch (...) {
-                mask[i] = false; 
+    // called with lock held: the next job, after the last one picked, that has a task to spare
+    shared_ptr<Job> pick(const Job* except = nullptr) {
+        for (size_t k = 0; k < jobs.size(); k++) {
+            shared_ptr<Job>& job = jobs[(cursor + k) % jobs.size()];
+            if (job.get() != except && job->next.load() < job->n && job->workers < job->max_workers) {
+                cursor = (cursor + k + 1) % jobs.size();
+                return job;
             }
         }
-        return mask;
+        return nullptr;
     }
 
     /**
-     * @brief Less-than comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements are less than the key
-     * @throws runtime_error If the column dtype is "string"
+     * @brief Runs tasks of job until it has none left, or other jobs are waiting for a turn.
      */
-    vector<bool> operator<(const double& key) {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
-        }
-
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
+    void run_tasks(Job& job, bool stay) {
+        int saved = scoped_policy();
+        scoped_policy() = job.policy;
+        for (;;) {
+            size_t i = job.next++;
+            if (i >= job.n) {
+                break;
+            }
             try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) < key); 
-                }
+                job.invoke(job.body, i);
             } catch (...) {
-                mask[i] = false; 
+                lock_guard<mutex> guard(job.error_mutex);
+                if (!job.error) {
+                    job.error = current_exception();
+                }
+            }
+            if (job.done.fetch_add(1) + 1 == job.n) {
+                lock_guard<mutex> guard(lock);
+                changed.notify_all();
+            }
+            if (!stay && jobs_waiting()) {
+                break;
             }
         }
-        return mask;
+        scoped_policy() = saved;
     }
 
-    /**
-     * @brief Greater-than comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements are greater than the key
-     * @throws runtime_error If the column dtype is "string"
-     */
-    vector<bool> operator>(const double& key) {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
-        }
+    bool jobs_waiting() const {
+        return num_jobs.load(memory_order_relaxed) > 1;
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) > key); 
-                }
-            } catch (...) {
-                mask[i] = false; 
+    void work() {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            shared_ptr<Job> job;
+            changed.wait(guard, [&] {
+                return stopping || (job = pick()) != nullptr;
+            });
+            if (stopping) {
+                return;
             }
+            job->workers++;
+            guard.unlock();
+            run_tasks(*job, false);
+            guard.lock();
+            job->workers--;
         }
-        return mask;
     }
 
-    /**
-     * @brief Less-than-or-equal comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements are less than or equal to the key
-     * @throws runtime_error If the column dtype is "string"
-     */
-    vector<bool> operator<=(const double& key) {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
+    void execute(const shared_ptr<Job>& job) {
+        {
+            lock_guard<mutex> guard(lock);
+            if (!started) {
+                start(0, false);
+            }
+            job->max_workers = std::min(job->max_workers, total_threads);
+            job->workers = 1; // the caller
+            jobs.push_back(job);
+            num_jobs = jobs.size();
         }
+        changed.notify_all();
+        run_tasks(*job, true);
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) <= key); 
-                }
-            } catch (...) {
-                mask[i] = false; 
+        // help the other jobs until the workers have finished this one's last tasks
+        unique_lock<mutex> guard(lock);
+        job->workers--;
+        for (;;) {
+            shared_ptr<Job> other;
+            changed.wait(guard, [&] {
+                return job->done.load() == job->n || (other = pick(job.get())) != nullptr;
+            });
+            if (job->done.load() == job->n) {
+                break;
             }
+            other->workers++;
+            guard.unlock();
+            run_tasks(*other, false);
+            guard.lock();
+            other->workers--;
+        }
+        jobs.erase(find(jobs.begin(), jobs.end(), job));
+        num_jobs = jobs.size();
+        guard.unlock();
+        if (job->error) {
+            rethrow_exception(job->error);
+        }
+    }
+};
+
+/**
+ * @brief Sets the execution policy of the calling thread until the scope ends.
+ *
+ * `{ ExecutionScope scope(ExecutionPolicy::sequential); DataFrame sorted = df.sort_values({"id"}); }`
+ * runs that one sort on the calling thread; the tasks of a parallel operation inherit
+ * the policy of the thread that started it.
+ */
+class ExecutionScope {
+public:
+    explicit ExecutionScope(ExecutionPolicy policy) : saved(ThreadPool::scoped_policy()) {
+        ThreadPool::scoped_policy() = static_cast<int>(policy);
+    }
+
+    ~ExecutionScope() {
+        ThreadPool::scoped_policy() = saved;
+    }
+
+    ExecutionScope(const ExecutionScope&) = delete;
+    ExecutionScope& operator=(const ExecutionScope&) = delete;
+
+private:
+    int saved;
+};
+
+/**
+ * @brief Runs f(0), ..., f(n-1), spreading the calls over up to num_threads threads of the pool.
+ *
+ * @param n Number of tasks
+ * @param num_threads Maximum number of threads to use, the caller included
+ *                    (0 = all of the pool, see ThreadPool::configure())
+ * @param f Callable invoked once with each task index
+ * @note Runs on the calling thread alone under ExecutionPolicy::sequential
+ * @note The first exception thrown by a task is rethrown on the calling thread
+ */
+template <typename F>
+void parallel_for(size_t n, size_t num_threads, F&& f) {
+    if (num_threads != 1 && n > 1) {
+        num_threads = std::min(num_threads == 0 ? n : num_threads, n);
+        if (num_threads > 1 && ThreadPool::concurrency() > 1) {
+            ThreadPool::run(n, num_threads, f);
+            return;
         }
-        return mask;
     }
+    for (size_t i = 0; i < n; i++) {
+        f(i);
+    }
+}
+
+/**
+ * @brief A packed sequence of bits stored in 64-bit words.
+ *
+ * Used by Column as its validity bitmap (bit i is set when element i holds a value
+ * and cleared when it is missing) and as the filter mask returned by the comparison
+ * operators. Masks combine with &, | and ~ word by word; when an operand is a
+ * temporary its storage is reused, so compound predicates such as
+ * `(df["a"] > 1) & ~(df["b"] == 2)` allocate no intermediate masks.
+ * Bits past size() in the last word are always zero.
+ */
+class Bitmap {
+public:
+    Bitmap() = default;
 
     /**
-     * @brief Greater-than-or-equal comparison operator for numeric columns.
-     * 
-     * @param key The numeric value to compare against
-     * @return Vector of boolean values indicating which elements are greater than or equal to the key
-     * @throws runtime_error If the column dtype is "string"
+     * @brief Creates a bitmap of n bits, all set to value.
+     *
+     * @param n Number of bits
+     * @param value Initial value of every bit
      */
-    vector<bool> operator>=(const double& key) {
-        if (dtype == "string") {
-           throw runtime_error("Error: Invalid comparison");
-        }
+    explicit Bitmap(size_t n, bool value = false) {
+        resize(n, value);
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            try {
-                if (data[i].empty()) {
-                    mask[i] = false; 
-                } else {
-                    mask[i] = (stod(data[i]) >= key); 
-                }
-            } catch (...) {
-                mask[i] = false; 
+    /**
+     * @brief Creates a bitmap from a vector of booleans.
+     *
+     * @param mask The bits, in order
+     */
+    explicit Bitmap(const vector<bool>& mask) {
+        resize(mask.size());
+        for (size_t idx = 0; idx < mask.size(); idx++) {
+            if (mask[idx]) {
+                set(idx);
             }
         }
-        return mask;
     }
 
-    /**
-     * @brief Equality comparison operator for string columns.
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements equal the key
-     * @throws runtime_error If the column dtype is "float" or "int"
-     */
-    vector<bool> operator==(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    size_t size() const {
+        return bits;
+    }
+
+    bool get(size_t idx) const {
+        return (words[idx >> 6] >> (idx & 63)) & 1;
+    }
+
+    bool operator[](size_t idx) const {
+        return get(idx);
+    }
+
+    void set(size_t idx, bool value = true) {
+        if (value) {
+            words[idx >> 6] |= (uint64_t(1) << (idx & 63));
+        } else {
+            words[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
         }
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] == key);
+    void push_back(bool value) {
+        if ((bits & 63) == 0) {
+            words.push_back(0);
         }
-        return mask;
+        bits++;
+        set(bits - 1, value);
     }
 
     /**
-     * @brief Inequality comparison operator for string columns.
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements are not equal to the key
-     * @throws runtime_error If the column dtype is "float" or "int"
+     * @brief Sets the bits in [begin, end), whole words at a time.
      */
-    vector<bool> operator!=(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    void set_range(size_t begin, size_t end) {
+        for (; begin < end && (begin & 63) != 0; begin++) {
+            set(begin);
         }
-
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] != key);
+        for (; begin + 64 <= end; begin += 64) {
+            words[begin >> 6] = ~uint64_t(0);
+        }
+        for (; begin < end; begin++) {
+            set(begin);
         }
-        return mask;
+    }
+
+    void reserve(size_t n) {
+        words.reserve((n + 63) / 64);
     }
 
     /**
-     * @brief Less-than comparison operator for string columns (lexicographic order).
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements are lexicographically less than the key
-     * @throws runtime_error If the column dtype is "float" or "int"
+     * @brief Resizes the bitmap, setting any newly added bits to value.
+     *
+     * @param n The new number of bits
+     * @param value The value of bits added past the old size
      */
-    vector<bool> operator<(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    void resize(size_t n, bool value = false) {
+        size_t old_bits = bits;
+        words.resize((n + 63) / 64, value ? ~uint64_t(0) : 0);
+        bits = n;
+        if (value) {
+            for (size_t idx = old_bits; idx < n && (idx & 63) != 0; idx++) {
+                set(idx);
+            }
         }
+        clear_tail();
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] < key);
+    /**
+     * @brief Counts the set bits.
+     *
+     * @return Number of bits set to 1
+     */
+    size_t count() const {
+        size_t cnt = 0;
+        for (uint64_t word : words) {
+            cnt += __builtin_popcountll(word);
         }
-        return mask;
+        return cnt;
     }
 
     /**
-     * @brief Greater-than comparison operator for string columns (lexicographic order).
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements are lexicographically greater than the key
-     * @throws runtime_error If the column dtype is "float" or "int"
+     * @brief Lists the positions of the set bits.
+     *
+     * @return Indices of the bits set to 1, in increasing order
      */
-    vector<bool> operator>(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    vector<size_t> indices() const {
+        vector<size_t> result;
+        result.reserve(count());
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+                result.push_back(w * 64 + __builtin_ctzll(word));
+            }
         }
+        return result;
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] > key);
+    /**
+     * @brief Converts the bitmap to a vector of booleans.
+     */
+    vector<bool> to_vector() const {
+        vector<bool> result(bits);
+        for (size_t idx = 0; idx < bits; idx++) {
+            result[idx] = get(idx);
         }
-        return mask;
+        return result;
     }
 
     /**
-     * @brief Less-than-or-equal comparison operator for string columns (lexicographic order).
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements are lexicographically less than or equal to the key
-     * @throws runtime_error If the column dtype is "float" or "int"
+     * @brief Appends all bits of another bitmap.
+     *
+     * @param other The bitmap to append
      */
-    vector<bool> operator<=(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    void append(const Bitmap& other) {
+        size_t shift = bits & 63;
+        if (shift == 0) {
+            words.insert(words.end(), other.words.begin(), other.words.end());
+        } else {
+            for (uint64_t word : other.words) {
+                words.back() |= word << shift;
+                words.push_back(word >> (64 - shift));
+            }
         }
+        bits += other.bits;
+        words.resize((bits + 63) / 64);
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] <= key);
+    /**
+     * @throws invalid_argument If the bitmaps have different sizes
+     */
+    Bitmap& operator&=(const Bitmap& other) {
+        check_size(other);
+        for (size_t w = 0; w < words.size(); w++) {
+            words[w] &= other.words[w];
         }
-        return mask;
+        return *this;
     }
 
     /**
-     * @brief Greater-than-or-equal comparison operator for string columns (lexicographic order).
-     * 
-     * @param key The string value to compare against
-     * @return Vector of boolean values indicating which elements are lexicographically greater than or equal to the key
-     * @throws runtime_error If the column dtype is "float" or "int"
+     * @throws invalid_argument If the bitmaps have different sizes
      */
-    vector<bool> operator>=(const string& key) {
-        if (dtype == "float" || dtype == "int") {
-           throw runtime_error("Error: Invalid comparison");
+    Bitmap& operator|=(const Bitmap& other) {
+        check_size(other);
+        for (size_t w = 0; w < words.size(); w++) {
+            words[w] |= other.words[w];
         }
+        return *this;
+    }
 
-        vector<bool> mask(data.size());
-        for (size_t i = 0; i < data.size(); i++) {
-            mask[i] = (data[i] >= key);
+    /**
+     * @brief Inverts every bit in place.
+     */
+    Bitmap& flip() {
+        for (uint64_t& word : words) {
+            word = ~word;
         }
-        return mask;
+        clear_tail();
+        return *this;
     }
-};
 
-/**
- * @brief Checks if a string represents a valid integer.
- * 
- * @param s The string to test
- * @return True if the string can be converted to an integer, false otherwise
- */
-bool is_integer(const string& s) {
-    try {
-        size_t pos;
-        stoi(s, &pos);
-        return pos == s.length();
-    } catch (...) {
-        return false;
+    Bitmap operator~() const & {
+        Bitmap result(*this);
+        return std::move(result.flip());
     }
-}
 
-/**
- * @brief Checks if a string represents a valid floating-point number.
- * 
- * @param s The string to test
- * @return True if the string can be converted to a double, false otherwise
- */
-bool is_float(const string& s) {
-    try {
-        size_t pos;
-        stod(s, &pos);
-        return pos == s.length();
-    } catch (...) {
-        return false;
+    Bitmap operator~() && {
+        return std::move(flip());
     }
-}
 
-/**
- * @brief A DataFrame class for handling tabular data similar to pandas DataFrame.
- * 
- * The DataFrame class provides functionality to load CSV files, manipulate data,
- * perform filtering operations, and save results. It automatically detects column
- * data types and provides various data analysis methods.
- */
-class DataFrame {
-private:
-    map<string, Column> col_data;
-    vector<vector<string>> row_data; // used for printing
-    string file_dir;
-public:
-    vector<string> columns;
+    const vector<uint64_t>& data() const {
+        return words;
+    }
 
     /**
-     * @brief Default constructor for creating an empty DataFrame.
-     */
-    DataFrame() = default;
-    
-    /**
-     * @brief Copy constructor for creating a DataFrame from another DataFrame.
-     * 
-     * @param other The DataFrame to copy from
+     * @brief Gives direct access to the words.
+     *
+     * @note Callers must keep the bits past size() in the last word cleared
      */
-    DataFrame(const DataFrame& other) 
-    : col_data(other.col_data), 
-      row_data(other.row_data), 
-      file_dir(other.file_dir), 
-      columns(other.columns) {}
+    vector<uint64_t>& data() {
+        return words;
+    }
 
-    /**
-     * @brief Constructor that loads data from a CSV file.
-     * 
-     * @param new_file_dir Path to the CSV file to load
-     * @throws runtime_error If the file cannot be found or opened
-     * @note Automatically detects column data types (int, float, or string)
-     * @note Handles missing values in CSV files
-     */
-    DataFrame(string new_file_dir) {
-        file_dir = new_file_dir;
-        ifstream file(file_dir);
+private:
+    vector<uint64_t> words;
+    size_t bits = 0;
 
-        if (!file) {
-            throw runtime_error("Error: File not found!");
+    void clear_tail() {
+        if (bits & 63) {
+            words.back() &= (uint64_t(1) << (bits & 63)) - 1;
         }
+    }
 
-        string line;
+    void check_size(const Bitmap& other) const {
+        if (other.bits != bits) {
+            throw invalid_argument("Bitmap sizes do not match!");
+        }
+    }
+};
 
-        vector<Column> temp_data;
+inline Bitmap operator&(const Bitmap& a, const Bitmap& b) {
+    Bitmap result(a);
+    return std::move(result &= b);
+}
 
-        int idx = 0;
-        while(getline(file, line)) {
-            char delim = ',';
-            stringstream ss(line);
-            string element;
-            vector<string> temp_row;
+inline Bitmap operator&(Bitmap&& a, const Bitmap& b) {
+    return std::move(a &= b);
+}
 
-            if (idx == 0) {
-                idx = 1;
-                while(getline(ss, element, delim)) {
-                    Column col;
-                    col.name = element;
-                    columns.push_back(element);
+inline Bitmap operator&(const Bitmap& a, Bitmap&& b) {
+    return std::move(b &= a);
+}
 
-                    temp_data.push_back(col);
-                    temp_row.push_back(element);
-                }
-                row_data.push_back(temp_row);
-                continue;
-            }
+inline Bitmap operator&(Bitmap&& a, Bitmap&& b) {
+    return std::move(a &= b);
+}
 
-            size_t jdx = 0;
-            while(getline(ss, element, delim)) {
-                temp_data[jdx].data.push_back(element);
-                temp_row.push_back(element);
-                jdx++;
-            }
+inline Bitmap operator|(const Bitmap& a, const Bitmap& b) {
+    Bitmap result(a);
+    return std::move(result |= b);
+}
 
-            if (temp_row.size() < row_data[0].size()) {
-                // there is a missing element in that row (in the last column)
-                temp_row.push_back("");
-                temp_data[jdx].data.push_back("");
-            }
+inline Bitmap operator|(Bitmap&& a, const Bitmap& b) {
+    return std::move(a |= b);
+}
 
-            row_data.push_back(temp_row);
-        }
+inline Bitmap operator|(const Bitmap& a, Bitmap&& b) {
+    return std::move(b |= a);
+}
 
-        for (auto& col : temp_data) {
-            bool all_int = true;
-            bool all_float = true;
-            for (const string& element : col.data) {
-                if (element.length() == 0) {
-                    // missing element
-                    continue;
-                }
-                if (!is_integer(element)) {
-                    all_int = false;
-                }
-                if (!is_float(element)) {
-                    all_float = false;
-                }
-                if (!all_int && !all_float) {
-                    break;
-                }
+inline Bitmap operator|(Bitmap&& a, Bitmap&& b) {
+    return std::move(a |= b);
+}
+
+/**
+ * @brief Comparison performed by the mask kernels.
+ */
+enum class CmpOp { eq, ne, lt, gt, le, ge };
+
+template <CmpOp op, typename T>
+inline bool compare_values(const T& a, const T& b) {
+    if constexpr (op == CmpOp::eq) {
+        return a == b;
+    } else if constexpr (op == CmpOp::ne) {
+        return a != b;
+    } else if constexpr (op == CmpOp::lt) {
+        return a < b;
+    } else if constexpr (op == CmpOp::gt) {
+        return a > b;
+    } else if constexpr (op == CmpOp::le) {
+        return a <= b;
+    } else {
+        return a >= b;
+    }
+}
+
+/**
+ * @brief Compares 64 consecutive numeric values against key with SIMD instructions.
+ *
+ * @param bits Receives one bit per value
+ * @return False if the target has no SIMD kernel for T, in which case bits is untouched
+ */
+template <CmpOp op, typename T>
+inline bool compare_word_simd(const T* values, T key, uint64_t& bits) {
+#if defined(__AVX2__)
+    bits = 0;
+    if constexpr (is_same_v<T, double>) {
+        constexpr int pred = op == CmpOp::eq ? _CMP_EQ_OQ : op == CmpOp::ne ? _CMP_NEQ_UQ
+                           : op == CmpOp::lt ? _CMP_LT_OQ : op == CmpOp::gt ? _CMP_GT_OQ
+                           : op == CmpOp::le ? _CMP_LE_OQ : _CMP_GE_OQ;
+        __m256d k = _mm256_set1_pd(key);
+        for (size_t i = 0; i < 64; i += 4) {
+            __m256d m = _mm256_cmp_pd(_mm256_loadu_pd(values + i), k, pred);
+            bits |= uint64_t(_mm256_movemask_pd(m)) << i;
+        }
+    } else {
+        // AVX2 only has 64-bit == and >, the other comparisons are built from them
+        __m256i k = _mm256_set1_epi64x(key);
+        for (size_t i = 0; i < 64; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            __m256i m;
+            if constexpr (op == CmpOp::eq || op == CmpOp::ne) {
+                m = _mm256_cmpeq_epi64(v, k);
+            } else if constexpr (op == CmpOp::gt || op == CmpOp::le) {
+                m = _mm256_cmpgt_epi64(v, k);
+            } else {
+                m = _mm256_cmpgt_epi64(k, v);
+            }
+            bits |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(m))) << i;
+        }
+        if constexpr (op == CmpOp::ne || op == CmpOp::le || op == CmpOp::ge) {
+            bits = ~bits;
+        }
+    }
+    return true;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    bits = 0;
+    for (size_t i = 0; i < 64; i += 2) {
+        uint64x2_t m;
+        if constexpr (is_same_v<T, double>) {
+            float64x2_t v = vld1q_f64(values + i);
+            float64x2_t k = vdupq_n_f64(key);
+            if constexpr (op == CmpOp::eq || op == CmpOp::ne) {
+                m = vceqq_f64(v, k);
+            } else if constexpr (op == CmpOp::lt) {
+                m = vcltq_f64(v, k);
+            } else if constexpr (op == CmpOp::gt) {
+                m = vcgtq_f64(v, k);
+            } else if constexpr (op == CmpOp::le) {
+                m = vcleq_f64(v, k);
+            } else {
+                m = vcgeq_f64(v, k);
             }
-            if (all_int) {
-                col.dtype = "int";
-            } else if (all_float) {
-                col.dtype = "float";
+        } else {
+            int64x2_t v = vld1q_s64(values + i);
+            int64x2_t k = vdupq_n_s64(key);
+            if constexpr (op == CmpOp::eq || op == CmpOp::ne) {
+                m = vceqq_s64(v, k);
+            } else if constexpr (op == CmpOp::lt) {
+                m = vcltq_s64(v, k);
+            } else if constexpr (op == CmpOp::gt) {
+                m = vcgtq_s64(v, k);
+            } else if constexpr (op == CmpOp::le) {
+                m = vcleq_s64(v, k);
             } else {
-                col.dtype = "string";
+                m = vcgeq_s64(v, k);
             }
         }
+        bits |= (vgetq_lane_u64(m, 0) & 1) << i;
+        bits |= (vgetq_lane_u64(m, 1) & 1) << (i + 1);
+    }
+    if constexpr (op == CmpOp::ne) {
+        bits = ~bits;
+    }
+    return true;
+#else
+    (void)values;
+    (void)key;
+    (void)bits;
+    return false;
+#endif
+}
 
-        for(Column col : temp_data) {
-            col_data[col.name] = col;
+/**
+ * @brief Compares n (at most 64) consecutive values against key and packs the results into one word.
+ *
+ * Full words of ints and doubles use AVX2 or NEON when the compiler targets them; the
+ * scalar fallback is branch-free so the compiler can vectorize it as well.
+ */
+template <CmpOp op, typename T>
+inline uint64_t compare_word(const T* values, const T& key, size_t n) {
+    uint64_t bits = 0;
+    if constexpr (is_same_v<T, int64_t> || is_same_v<T, double>) {
+        if (n == 64 && compare_word_simd<op>(values, key, bits)) {
+            return bits;
         }
     }
-
+    for (size_t i = 0; i < n; i++) {
+        bits |= uint64_t(compare_values<op>(values[i], key)) << i;
+    }
+    return bits;
+}
+
+/**
+ * @brief Compares every value against key, writing one bit per value into words.
+ *
+ * @param values The values to compare
+ * @param n Number of values
+ * @param key The value to compare against
+ * @param words Output words, at least (n + 63) / 64 of them
+ */
+template <CmpOp op, typename T>
+inline void compare_kernel(const T* values, size_t n, const T& key, uint64_t* words) {
+    for (size_t w = 0; w * 64 < n; w++) {
+        words[w] = compare_word<op>(values + w * 64, key, std::min<size_t>(64, n - w * 64));
+    }
+}
+
+/**
+ * @brief Per-block minimum and maximum of a numeric column (a zone map).
+ *
+ * Lets a comparison skip the blocks whose bounds decide it for every row, which on
+ * sorted or clustered data (timestamps, ids) leaves only a few blocks to scan. A block
+ * without present values has min > max; a block holding a NaN has NaN bounds, which
+ * decide no comparison, so it is always scanned.
+ */
+template <typename T>
+struct ZoneMap {
+    static constexpr size_t block_rows = 4096; // a multiple of 64, so blocks start on mask words
+
+    vector<T> min;
+    vector<T> max;
+    bool sorted = true; // the present values are in ascending order (NaN skipped)
+    bool complete = true; // no value is missing or NaN
+
+    size_t num_blocks() const {
+        return min.size();
+    }
+
+    /**
+     * @brief Computes the zone map of a column's values in one pass.
+     */
+    static ZoneMap build(const vector<T>& values, const Bitmap& validity) {
+        ZoneMap zones;
+        size_t n = values.size();
+        size_t blocks = (n + block_rows - 1) / block_rows;
+        zones.min.assign(blocks, numeric_limits<T>::max());
+        zones.max.assign(blocks, numeric_limits<T>::lowest());
+        bool seen = false;
+        T last{};
+        for (size_t b = 0; b < blocks; b++) {
+            T lo = zones.min[b];
+            T hi = zones.max[b];
+            bool nan = false;
+            for (size_t row = b * block_rows; row < std::min(n, (b + 1) * block_rows); row++) {
+                T value = values[row];
+                if (!validity.get(row) || value != value) {
+                    nan |= validity.get(row);
+                    zones.complete = false;
+                    continue;
+                }
+                lo = std::min(lo, value);
+                hi = std::max(hi, value);
+                zones.sorted &= !seen || !(value < last);
+                last = value;
+                seen = true;
+            }
+            if constexpr (is_floating_point_v<T>) {
+                if (nan) {
+                    lo = hi = numeric_limits<T>::quiet_NaN();
+                }
+            }
+            zones.min[b] = lo;
+            zones.max[b] = hi;
+        }
+        return zones;
+    }
+
+    /**
+     * @brief Decides `value op key` for the whole of block b, if its bounds allow.
+     *
+     * @return 1 if every present value matches, 0 if none does, -1 if the block must be scanned
+     */
+    template <CmpOp op>
+    int classify(size_t b, const T& key) const {
+        const T& lo = min[b];
+        const T& hi = max[b];
+        if constexpr (op == CmpOp::eq) {
+            return key < lo || key > hi ? 0 : lo == key && hi == key ? 1 : -1;
+        } else if constexpr (op == CmpOp::ne) {
+            return key < lo || key > hi ? 1 : lo == key && hi == key ? 0 : -1;
+        } else if constexpr (op == CmpOp::lt) {
+            return lo >= key ? 0 : hi < key ? 1 : -1;
+        } else if constexpr (op == CmpOp::le) {
+            return lo > key ? 0 : hi <= key ? 1 : -1;
+        } else if constexpr (op == CmpOp::gt) {
+            return hi <= key ? 0 : lo > key ? 1 : -1;
+        } else {
+            return hi < key ? 0 : lo >= key ? 1 : -1;
+        }
+    }
+};
+
+enum class ArithOp { add, sub, mul, div, min, max };
+
+/**
+ * @brief A number given to a Column operator; integers stay exact for "int" columns.
+ */
+struct Scalar {
+    double number;
+    int64_t integer = 0;
+    bool integral = false;
+
+    template <typename T, typename = enable_if_t<is_arithmetic_v<T>>>
+    Scalar(T x) : number(static_cast<double>(x)) {
+        if constexpr (is_integral_v<T>) {
+            integer = static_cast<int64_t>(x);
+            integral = true;
+        }
+    }
+};
+
+enum class MathFn { neg, abs, sqrt, log, exp };
+
+/**
+ * @brief Applies an arithmetic operator; int64 results wrap around on overflow like NumPy's.
+ */
+template <ArithOp op, typename T>
+inline T arith_value(T a, T b) {
+    if constexpr (is_integral_v<T>) {
+        uint64_t x = static_cast<uint64_t>(a);
+        uint64_t y = static_cast<uint64_t>(b);
+        if constexpr (op == ArithOp::add) {
+            return static_cast<T>(x + y);
+        } else if constexpr (op == ArithOp::sub) {
+            return static_cast<T>(x - y);
+        } else if constexpr (op == ArithOp::mul) {
+            return static_cast<T>(x * y);
+        } else if constexpr (op == ArithOp::min) {
+            return std::min(a, b);
+        } else {
+            static_assert(op == ArithOp::max, "integer division yields float columns");
+            return std::max(a, b);
+        }
+    } else if constexpr (op == ArithOp::min) {
+        return std::min(a, b); // keeps a NaN a
+    } else if constexpr (op == ArithOp::max) {
+        return std::max(a, b);
+    } else if constexpr (op == ArithOp::add) {
+        return a + b;
+    } else if constexpr (op == ArithOp::sub) {
+        return a - b;
+    } else if constexpr (op == ArithOp::mul) {
+        return a * b;
+    } else {
+        return a / b;
+    }
+}
+
+template <MathFn fn, typename T>
+inline T math_value(T x) {
+    if constexpr (is_integral_v<T>) {
+        uint64_t negated = 0 - static_cast<uint64_t>(x);
+        if constexpr (fn == MathFn::neg) {
+            return static_cast<T>(negated);
+        } else {
+            static_assert(fn == MathFn::abs, "sqrt, log and exp yield float columns");
+            return x < 0 ? static_cast<T>(negated) : x;
+        }
+    } else if constexpr (fn == MathFn::neg) {
+        return -x;
+    } else if constexpr (fn == MathFn::abs) {
+        return std::fabs(x);
+    } else if constexpr (fn == MathFn::sqrt) {
+        return std::sqrt(x);
+    } else if constexpr (fn == MathFn::log) {
+        return std::log(x);
+    } else {
+        return std::exp(x);
+    }
+}
+
+/**
+ * @brief How Column::sum() and Column::mean() accumulate their values.
+ */
+enum class SumMode {
+    fast,    // blocked summation over independent lanes, vectorized; error grows with the block size
+    precise  // Neumaier-compensated lanes; error stays near one rounding regardless of length
+};
+
+/**
+ * @brief Adds x to sum, keeping the rounding error in err (Neumaier's variant of Kahan summation).
+ */
+inline void compensated_add(double& sum, double& err, double x) {
+    double t = sum + x;
+    err += std::fabs(sum) >= std::fabs(x) ? (sum - t) + x : (x - t) + sum;
+    sum = t;
+}
+
+/**
+ * @brief Summary statistics of the non-missing values of a numeric column.
+ *
+ * Partial results computed over separate row ranges (or separate DataFrames) can be
+ * combined with merge(), which uses Chan's update so the variance stays accurate and
+ * compensated addition so the sum of many partial sums does not drift.
+ */
+struct ColumnStats {
+    size_t count = 0; // number of non-missing values
+    double sum = 0;
+    double sum_err = 0; // rounding error of sum that merge() has not added back yet
+    double min = numeric_limits<double>::quiet_NaN();
+    double max = numeric_limits<double>::quiet_NaN();
+    double m2 = 0; // sum of squared deviations from the mean
+
+    double total() const {
+        return sum + sum_err;
+    }
+
+    double mean() const {
+        return count ? total() / count : numeric_limits<double>::quiet_NaN();
+    }
+
+    /**
+     * @brief Returns the variance.
+     *
+     * @param ddof Delta degrees of freedom; the divisor is count - ddof (default: 1)
+     */
+    double var(size_t ddof = 1) const {
+        return count > ddof ? m2 / (count - ddof) : numeric_limits<double>::quiet_NaN();
+    }
+
+    /**
+     * @brief Returns the standard deviation.
+     *
+     * @param ddof Delta degrees of freedom; the divisor is count - ddof (default: 1)
+     */
+    double std(size_t ddof = 1) const {
+        return sqrt(var(ddof));
+    }
+
+    /**
+     * @brief Folds in the statistics of another range of values.
+     *
+     * @param other Statistics of values not yet counted in this object
+     */
+    void merge(const ColumnStats& other) {
+        if (other.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        double delta = other.mean() - mean();
+        double n = static_cast<double>(count + other.count);
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * static_cast<double>(other.count) / n);
+        sum_err += other.sum_err;
+        compensated_add(sum, sum_err, other.sum);
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// columns at least this long are reduced on several threads
+constexpr size_t parallel_min_rows = 1 << 20;
+
+/**
+ * @brief Checks, a range at a time, that the present values of a column are in ascending
+ *        order (see Column::is_sorted()); NaN values are skipped.
+ */
+template <typename T>
+struct OrderCheck {
+    bool ascending = true;
+    bool seen = false; // whether first and last hold a value
+    T first{};
+    T last{};
+
+    void add(T x) {
+        if (!(x == x)) {
+            return;
+        }
+        if (seen && x < last) {
+            ascending = false;
+        }
+        if (!seen) {
+            first = x;
+            seen = true;
+        }
+        last = x;
+    }
+
+    // n consecutive present values, e.g. a full word of them
+    void add_run(const T* v, size_t n) {
+        if (!ascending || n == 0) {
+            return;
+        }
+        bool clean = true;
+        bool down = false;
+        for (size_t i = 0; i < n; i++) {
+            clean &= v[i] == v[i];
+        }
+        if (!clean) {
+            for (size_t i = 0; i < n; i++) {
+                add(v[i]);
+            }
+            return;
+        }
+        for (size_t i = 1; i < n; i++) {
+            down |= v[i] < v[i - 1];
+        }
+        if ((seen && v[0] < last) || down) {
+            ascending = false;
+        }
+        if (!seen) {
+            first = v[0];
+            seen = true;
+        }
+        last = v[n - 1];
+    }
+
+    // the check of the range that follows this one
+    void merge(const OrderCheck& next) {
+        if (!next.seen) {
+            return;
+        }
+        if (!seen) {
+            *this = next;
+            return;
+        }
+        ascending = ascending && next.ascending && !(next.first < last);
+        last = next.last;
+    }
+};
+
+/**
+ * @brief Reduces values[begin, end) to count, sum, min and max, and m2 when moments is set.
+ *
+ * Full words of valid values run through a branch-free loop over independent lanes,
+ * which the compiler can vectorize; other words visit only their set bits. NaN values
+ * count as missing. The variance pass reuses the block while it is still in cache.
+ * With SumMode::precise every lane carries a Neumaier error term.
+ *
+ * @param values The column's typed buffer
+ * @param valid The column's validity words
+ * @param begin First row, a multiple of 64
+ * @param end One past the last row
+ * @param moments Whether to compute m2
+ * @param order If set, also checks the order of the values while they are in cache
+ */
+template <SumMode mode, typename T>
+ColumnStats reduce_block(const T* values, const uint64_t* valid, size_t begin, size_t end, bool moments,
+                         OrderCheck<T>* order = nullptr) {
+    constexpr size_t lanes = 8;
+    auto keep = [](T x) {
+        if constexpr (is_floating_point_v<T>) {
+            return x == x;
+        } else {
+            (void)x;
+            return true;
+        }
+    };
+
+    size_t cnt[lanes] = {};
+    double sum[lanes] = {};
+    double err[lanes] = {};
+    T mn[lanes];
+    T mx[lanes];
+    for (size_t j = 0; j < lanes; j++) {
+        mn[j] = is_floating_point_v<T> ? numeric_limits<T>::infinity() : numeric_limits<T>::max();
+        mx[j] = is_floating_point_v<T> ? -numeric_limits<T>::infinity() : numeric_limits<T>::lowest();
+    }
+    auto add = [&](size_t j, double x) {
+        if constexpr (mode == SumMode::precise) {
+            compensated_add(sum[j], err[j], x);
+        } else {
+            sum[j] += x;
+        }
+    };
+
+    for (size_t w0 = begin; w0 < end; w0 += 64) {
+        const T* v = values + w0;
+        uint64_t word = valid[w0 / 64];
+        if (end - w0 >= 64 && word == ~uint64_t(0)) {
+            for (size_t i = 0; i < 64; i += lanes) {
+                for (size_t j = 0; j < lanes; j++) {
+                    T x = v[i + j];
+                    bool ok = keep(x);
+                    cnt[j] += ok;
+                    add(j, ok ? static_cast<double>(x) : 0.0);
+                    mn[j] = ok && x < mn[j] ? x : mn[j];
+                    mx[j] = ok && x > mx[j] ? x : mx[j];
+                }
+            }
+            if (order) {
+                order->add_run(v, 64);
+            }
+            continue;
+        }
+        for (; word != 0; word &= word - 1) {
+            T x = v[__builtin_ctzll(word)];
+            if (order) {
+                order->add(x);
+            }
+            if (keep(x)) {
+                cnt[0]++;
+                add(0, static_cast<double>(x));
+                mn[0] = std::min(mn[0], x);
+                mx[0] = std::max(mx[0], x);
+            }
+        }
+    }
+
+    ColumnStats stats;
+    T block_min = mn[0];
+    T block_max = mx[0];
+    for (size_t j = 0; j < lanes; j++) {
+        stats.count += cnt[j];
+        stats.sum_err += err[j];
+        compensated_add(stats.sum, stats.sum_err, sum[j]);
+        block_min = std::min(block_min, mn[j]);
+        block_max = std::max(block_max, mx[j]);
+    }
+    if (stats.count == 0) {
+        return stats;
+    }
+    stats.min = static_cast<double>(block_min);
+    stats.max = static_cast<double>(block_max);
+
+    if (moments) {
+        double mean = stats.mean();
+        double m2[lanes] = {};
+        for (size_t w0 = begin; w0 < end; w0 += 64) {
+            const T* v = values + w0;
+            uint64_t word = valid[w0 / 64];
+            if (end - w0 >= 64 && word == ~uint64_t(0)) {
+                for (size_t i = 0; i < 64; i += lanes) {
+                    for (size_t j = 0; j < lanes; j++) {
+                        double d = static_cast<double>(v[i + j]) - mean;
+                        m2[j] += keep(v[i + j]) ? d * d : 0.0;
+                    }
+                }
+                continue;
+            }
+            for (; word != 0; word &= word - 1) {
+                T x = v[__builtin_ctzll(word)];
+                if (keep(x)) {
+                    double d = static_cast<double>(x) - mean;
+                    m2[0] += d * d;
+                }
+            }
+        }
+        for (size_t j = 0; j < lanes; j++) {
+            stats.m2 += m2[j];
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief Reduces a whole typed buffer, splitting long columns across threads.
+ *
+ * Rows are cut into fixed ranges independent of the thread count and merged in
+ * order, so the result does not depend on how many threads took part. Block sums
+ * are always combined with compensated addition, so even SumMode::fast only loses
+ * precision within a block of block_rows values.
+ *
+ * @param values The column's typed buffer
+ * @param validity The column's validity bitmap
+ * @param moments Whether to compute m2 (needed for var/std)
+ * @param mode How values are summed within a block
+ * @param sorted If set, receives whether the present values are in ascending order,
+ *               checked in the same pass
+ */
+template <typename T>
+ColumnStats reduce_column(const vector<T>& values, const Bitmap& validity, bool moments, SumMode mode = SumMode::fast,
+                          bool* sorted = nullptr) {
+    constexpr size_t block_rows = 4096; // 32KB of values, reused by the variance pass while in cache
+    constexpr size_t task_rows = 1 << 18;
+    size_t n = values.size();
+    size_t num_tasks = (n + task_rows - 1) / task_rows;
+
+    vector<ColumnStats> partial(num_tasks);
+    vector<OrderCheck<T>> orders(sorted ? num_tasks : 0);
+    parallel_for(num_tasks, n >= parallel_min_rows ? 0 : 1, [&](size_t task) {
+        size_t task_end = std::min(n, (task + 1) * task_rows);
+        OrderCheck<T>* order = sorted ? &orders[task] : nullptr;
+        for (size_t begin = task * task_rows; begin < task_end; begin += block_rows) {
+            size_t end = std::min(task_end, begin + block_rows);
+            const uint64_t* valid = validity.data().data();
+            partial[task].merge(mode == SumMode::precise
+                ? reduce_block<SumMode::precise>(values.data(), valid, begin, end, moments, order)
+                : reduce_block<SumMode::fast>(values.data(), valid, begin, end, moments, order));
+        }
+    });
+
+    ColumnStats stats;
+    for (const ColumnStats& part : partial) {
+        stats.merge(part);
+    }
+    if (sorted) {
+        OrderCheck<T> order;
+        for (const OrderCheck<T>& part : orders) {
+            order.merge(part);
+        }
+        *sorted = order.ascending;
+    }
+    stats.sum = stats.total();
+    stats.sum_err = 0;
+    return stats;
+}
+
+/**
+ * @brief The values of a string column: one contiguous character buffer plus offsets (Arrow's layout).
+ *
+ * Value i occupies chars [offsets[i], offsets[i + 1]), so appending a value copies its
+ * characters instead of allocating a string, a whole column costs two allocations, and it
+ * can be saved or loaded with one copy per buffer.
+ */
+class StringBuffer {
+public:
+    StringBuffer() : offsets(1, 0) {}
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    string_view operator[](size_t idx) const {
+        return string_view(chars.data() + offsets[idx], offsets[idx + 1] - offsets[idx]);
+    }
+
+    void push_back(string_view value) {
+        chars.insert(chars.end(), value.begin(), value.end());
+        offsets.push_back(chars.size());
+    }
+
+    /**
+     * @brief Reserves room for n values holding bytes characters in total.
+     */
+    void reserve(size_t n, size_t bytes = 0) {
+        offsets.reserve(n + 1);
+        chars.reserve(bytes);
+    }
+
+    /**
+     * @brief Appends all values of another buffer.
+     */
+    void append(const StringBuffer& other) {
+        uint64_t base = chars.size();
+        chars.insert(chars.end(), other.chars.begin(), other.chars.end());
+        offsets.reserve(offsets.size() + other.size());
+        for (size_t idx = 1; idx < other.offsets.size(); idx++) {
+            offsets.push_back(base + other.offsets[idx]);
+        }
+    }
+
+    /**
+     * @brief Replaces the contents with n values copied from raw buffers.
+     *
+     * @param values The characters the offsets point into
+     * @param value_offsets n + 1 offsets delimiting each value
+     * @param n Number of values
+     */
+    void assign(const char* values, const uint64_t* value_offsets, size_t n) {
+        uint64_t base = value_offsets[0];
+        chars.assign(values + base, values + value_offsets[n]);
+        offsets.resize(n + 1);
+        for (size_t idx = 0; idx <= n; idx++) {
+            offsets[idx] = value_offsets[idx] - base;
+        }
+    }
+
+    /**
+     * @brief Gathers the values at the given indices; Column::npos yields an empty value.
+     */
+    StringBuffer take(const vector<size_t>& indices, size_t npos) const {
+        StringBuffer result;
+        size_t bytes = 0;
+        for (size_t idx : indices) {
+            bytes += idx == npos ? 0 : offsets[idx + 1] - offsets[idx];
+        }
+        result.reserve(indices.size(), bytes);
+        for (size_t idx : indices) {
+            result.push_back(idx == npos ? string_view() : (*this)[idx]);
+        }
+        return result;
+    }
+
+    void clear() {
+        vector<char>().swap(chars);
+        offsets.assign(1, 0);
+    }
+
+    const vector<char>& char_data() const {
+        return chars;
+    }
+
+    const vector<uint64_t>& offset_data() const {
+        return offsets;
+    }
+
+private:
+    vector<char> chars;
+    vector<uint64_t> offsets; // size() + 1 entries, offsets[0] == 0
+};
+
+template <typename T>
+class TypedColumn;
+class DataFrame;
+
+/**
+ * @brief Represents a single column in a DataFrame with associated operations.
+ *
+ * The Column class stores its values in a contiguous typed buffer chosen by `dtype`
+ * (int64 for "int", double for "float", a StringBuffer for "string") together with a validity
+ * bitmap marking missing values. Values are parsed once when the column is filled, so
+ * statistical operations, filtering, and data manipulation read the native values directly.
+ *
+ * The buffers are reference-counted and copied on write: copying a column (or a DataFrame)
+ * shares them, and they are only duplicated when one of the copies is modified.
+ *
+ * Operations test `dtype` once and then run a loop specialized for the element type;
+ * as<T>() and visit() give the same typed access to code outside the class (see TypedColumn).
+ *
+ * @note As with iterators into a container, a reference returned by str_at(),
+ *       int_values(), valid() etc. stays valid only until the column is modified.
+ */
+class Column {
+public:
+    string name; // column's name
+    string dtype = "string"; // data type
+
+    static constexpr size_t npos = numeric_limits<size_t>::max(); // "no row", see take()
+    friend std::ostream& operator<<(std::ostream& os, const Column& col);
+
+    /**
+     * @brief Returns the number of elements in the column, including missing ones.
+     */
+    size_t size() const {
+        return data().validity.size();
+    }
+
+    /**
+     * @brief Checks whether the element at idx is missing.
+     *
+     * @param idx The row index
+     * @return True if the element is missing, false otherwise
+     */
+    bool is_na(size_t idx) const {
+        return !data().validity.get(idx);
+    }
+
+    /**
+     * @brief Returns the element at idx formatted as a string.
+     *
+     * @param idx The row index
+     * @return The formatted value, or an empty string if the element is missing
+     */
+    string at(size_t idx) const {
+        const Buffers& store = data();
+        if (is_na(idx)) {
+            return "";
+        }
+        if (dtype == "int") {
+            return to_string(store.int_data[idx]);
+        }
+        if (dtype == "float") {
+            return format_float(store.float_data[idx]);
+        }
+        return string(str_at(idx));
+    }
+
+    /**
+     * @brief Returns the element at idx of a string column.
+     *
+     * @param idx The row index
+     * @return A view of the value (empty if the element is missing), valid until the column is modified
+     * @note Works for both plain and dictionary-encoded columns
+     */
+    string_view str_at(size_t idx) const {
+        const Buffers& store = data();
+        if (store.encoded) {
+            return store.validity.get(idx) ? string_view(store.dict[store.dict_codes[idx]]) : string_view();
+        }
+        return store.str_data[idx];
+    }
+
+    /**
+     * @brief Appends the text of the element at index idx to out, formatted as by at().
+     *
+     * @param idx Index of the element
+     * @param out String the text is appended to (nothing is appended for a missing value)
+     * @note Numbers are written with to_chars, without building a temporary string
+     */
+    void format_to(size_t idx, string& out) const {
+        const Buffers& store = data();
+        if (is_na(idx)) {
+            return;
+        }
+        char buf[32];
+        if (dtype == "int") {
+            auto res = to_chars(buf, buf + sizeof(buf), store.int_data[idx]);
+            out.append(buf, res.ptr);
+        } else if (dtype == "float") {
+            auto res = to_chars(buf, buf + sizeof(buf), store.float_data[idx]);
+            out.append(buf, res.ptr);
+        } else {
+            out += str_at(idx);
+        }
+    }
+
+    /**
+     * @brief Appends a value to the end of the column.
+     *
+     * @tparam T The type of the value (integral, floating-point, or string)
+     * @param x The value to append
+     * @note The value is converted to the column's dtype, which must be set beforehand
+     */
+    template <typename T>
+    void append(const T& x) {
+        Buffers& store = edit();
+        if constexpr (is_arithmetic_v<T>) {
+            if (dtype == "int") {
+                store.int_data.push_back(static_cast<int64_t>(x));
+            } else if (dtype == "float") {
+                store.float_data.push_back(static_cast<double>(x));
+            } else {
+                append_str(to_string(x));
+            }
+        } else {
+            if (dtype != "string") {
+                throw invalid_argument("Invalid type: Column::append() expects a numeric value for int or float columns");
+            }
+            append_str(x);
+        }
+        store.validity.push_back(true);
+    }
+
+    /**
+     * @brief Appends a missing value to the end of the column.
+     */
+    void append_na() {
+        Buffers& store = edit();
+        if (dtype == "int") {
+            store.int_data.push_back(0);
+        } else if (dtype == "float") {
+            store.float_data.push_back(0);
+        } else if (store.encoded) {
+            store.dict_codes.push_back(0);
+        } else {
+            store.str_data.push_back(string_view());
+        }
+        store.validity.push_back(false);
+    }
+
+    /**
+     * @brief Reserves storage for n elements of the column's dtype.
+     *
+     * @param n Number of elements to reserve
+     */
+    void reserve(size_t n) {
+        Buffers& store = edit();
+        if (dtype == "int") {
+            store.int_data.reserve(n);
+        } else if (dtype == "float") {
+            store.float_data.reserve(n);
+        } else if (store.encoded) {
+            store.dict_codes.reserve(n);
+        } else {
+            store.str_data.reserve(n);
+        }
+        store.validity.reserve(n);
+    }
+
+    /**
+     * @brief Checks whether the string column is dictionary-encoded.
+     */
+    bool is_encoded() const {
+        return data().encoded;
+    }
+
+    /**
+     * @brief Dictionary-encodes a string column: each distinct value is stored once and
+     *        every row holds a 32-bit code into that table.
+     *
+     * Columns with few distinct values (country, status, category, ...) then take a
+     * fraction of the memory, and equality filters compare integer codes instead of strings.
+     * Appending to an encoded column keeps it encoded.
+     *
+     * @param max_distinct Leave the column plain if it has more distinct values than this
+     * @return True if the column is encoded afterwards
+     * @throws invalid_argument If the column dtype is not "string"
+     */
+    bool encode(size_t max_distinct = numeric_limits<uint32_t>::max()) {
+        if (dtype != "string") {
+            throw invalid_argument("Invalid type: Column::encode() expects `dtype` to be string");
+        }
+        if (data().encoded) {
+            return true;
+        }
+        Buffers& store = edit();
+
+        vector<uint32_t> codes;
+        codes.reserve(store.str_data.size());
+        for (size_t idx = 0; idx < store.str_data.size(); idx++) {
+            if (!store.validity.get(idx)) {
+                codes.push_back(0);
+            } else if (store.dict.size() >= max_distinct && !store.dict_index.count(string(store.str_data[idx]))) {
+                clear_dict();
+                return false;
+            } else {
+                codes.push_back(intern(store.str_data[idx]));
+            }
+        }
+        store.dict_codes = std::move(codes);
+        store.str_data.clear();
+        store.encoded = true;
+        return true;
+    }
+
+    /**
+     * @brief Turns a dictionary-encoded column back into one string per row.
+     */
+    void decode() {
+        if (!data().encoded) {
+            return;
+        }
+        Buffers& store = edit();
+        size_t bytes = 0;
+        for (size_t idx = 0; idx < store.dict_codes.size(); idx++) {
+            bytes += store.validity.get(idx) ? store.dict[store.dict_codes[idx]].size() : 0;
+        }
+        store.str_data.clear();
+        store.str_data.reserve(store.dict_codes.size(), bytes);
+        for (size_t idx = 0; idx < store.dict_codes.size(); idx++) {
+            store.str_data.push_back(store.validity.get(idx) ? string_view(store.dict[store.dict_codes[idx]]) : string_view());
+        }
+        vector<uint32_t>().swap(store.dict_codes);
+        clear_dict();
+        store.encoded = false;
+    }
+
+    /**
+     * @brief Returns the distinct values of a dictionary-encoded column, indexed by code.
+     */
+    const vector<string>& categories() const {
+        return data().dict;
+    }
+
+    /**
+     * @brief Returns the per-row codes of a dictionary-encoded column (0 for missing rows).
+     */
+    const vector<uint32_t>& codes() const {
+        return data().dict_codes;
+    }
+
+    /**
+     * @brief Replaces the column's contents with n values copied from raw buffers.
+     *
+     * @param values n int64 or double values, or for string columns the concatenated characters
+     * @param n Number of elements
+     * @param valid_words (n + 63) / 64 validity words, bit i set when element i is present
+     * @param str_offsets For string columns, n + 1 offsets into values delimiting each string
+     * @param rows If set, only these elements (indices below n) are copied, in this order
+     * @note The column's dtype must be set beforehand
+     */
+    void assign_buffers(const char* values, size_t n, const uint64_t* valid_words, const uint64_t* str_offsets = nullptr,
+                        const vector<size_t>* rows = nullptr) {
+        Buffers& store = edit();
+        store.int_data.clear();
+        store.float_data.clear();
+        store.str_data.clear();
+        store.dict_codes.clear();
+        clear_dict();
+        store.encoded = false;
+        if (rows) {
+            size_t m = rows->size();
+            store.validity = Bitmap(m);
+            if (dtype == "int") {
+                store.int_data.resize(m);
+                for (size_t idx = 0; idx < m; idx++) {
+                    memcpy(&store.int_data[idx], values + (*rows)[idx] * sizeof(int64_t), sizeof(int64_t));
+                }
+            } else if (dtype == "float") {
+                store.float_data.resize(m);
+                for (size_t idx = 0; idx < m; idx++) {
+                    memcpy(&store.float_data[idx], values + (*rows)[idx] * sizeof(double), sizeof(double));
+                }
+            } else {
+                store.str_data.reserve(m);
+                for (size_t row : *rows) {
+                    store.str_data.push_back(string_view(values + str_offsets[row], str_offsets[row + 1] - str_offsets[row]));
+                }
+            }
+            for (size_t idx = 0; idx < m; idx++) {
+                size_t row = (*rows)[idx];
+                store.validity.set(idx, (valid_words[row / 64] >> (row % 64)) & 1);
+            }
+            return;
+        }
+        if (n == 0) {
+            store.validity = Bitmap();
+            return;
+        }
+        if (dtype == "int") {
+            store.int_data.resize(n);
+            memcpy(store.int_data.data(), values, n * sizeof(int64_t));
+        } else if (dtype == "float") {
+            store.float_data.resize(n);
+            memcpy(store.float_data.data(), values, n * sizeof(double));
+        } else {
+            store.str_data.assign(values, str_offsets, n);
+        }
+        store.validity = Bitmap(n);
+        memcpy(store.validity.data().data(), valid_words, (n + 63) / 64 * sizeof(uint64_t));
+        if (n & 63) {
+            store.validity.data().back() &= (uint64_t(1) << (n & 63)) - 1;
+        }
+    }
+
+    const vector<int64_t>& int_values() const {
+        return data().int_data;
+    }
+
+    const vector<double>& float_values() const {
+        return data().float_data;
+    }
+
+    /**
+     * @brief Returns the zone map of an int (T = int64_t) or float (T = double) column.
+     *
+     * Built on first use, or restored by read_binary() from the file, and kept until the
+     * column is modified.
+     *
+     * @throws invalid_argument If T does not match the column dtype
+     */
+    template <typename T>
+    const ZoneMap<T>& zone_map() const {
+        if (dtype != (is_same_v<T, int64_t> ? "int" : "float")) {
+            throw invalid_argument("Invalid type: Column::zone_map() expects T to match `dtype`");
+        }
+        const Buffers& store = data();
+        optional<ZoneMap<T>>& zones = store.summary.zones<T>();
+        {
+            lock_guard<mutex> guard(store.summary.lock);
+            if (zones) {
+                return *zones;
+            }
+        }
+        // built without the lock, like stats_of(); once set the map is never replaced
+        // until the column is modified, so the returned reference stays valid
+        ZoneMap<T> built;
+        if constexpr (is_same_v<T, int64_t>) {
+            built = ZoneMap<T>::build(store.int_data, store.validity);
+        } else {
+            built = ZoneMap<T>::build(store.float_data, store.validity);
+        }
+        lock_guard<mutex> guard(store.summary.lock);
+        if (!zones) {
+            store.summary.sorted = built.sorted;
+            zones = std::move(built);
+        }
+        return *zones;
+    }
+
+    /**
+     * @brief Attaches a zone map computed elsewhere, e.g. stored next to the values in a file.
+     *
+     * @note zones must describe the column's current values, or comparisons will be wrong
+     */
+    template <typename T>
+    void assign_zone_map(ZoneMap<T> zones) {
+        Buffers& store = edit();
+        store.summary.sorted = zones.sorted;
+        store.summary.zones<T>() = std::move(zones);
+    }
+
+    /**
+     * @throws invalid_argument If the column is dictionary-encoded (use str_at() or decode())
+     */
+    const StringBuffer& str_values() const {
+        const Buffers& store = data();
+        if (store.encoded) {
+            throw invalid_argument("Invalid type: Column::str_values() expects a plain string column, use str_at() or decode()");
+        }
+        return store.str_data;
+    }
+
+    const Bitmap& valid() const {
+        return data().validity;
+    }
+
+    /**
+     * @brief Returns the column with its element type fixed at compile time; see TypedColumn.
+     *
+     * @tparam T int64_t for an "int", double for a "float" or string_view for a "string" column
+     * @throws invalid_argument If T does not match the column dtype
+     */
+    template <typename T>
+    TypedColumn<T> as() const;
+
+    /**
+     * @brief Calls f with the column as the TypedColumn of its dtype, choosing the type once.
+     *
+     * `col.visit([](auto typed) { ... })` compiles the body for each element type, so its
+     * loops run on native values without testing the dtype per row.
+     *
+     * @param f Callable taking TypedColumn<int64_t>, TypedColumn<double> and
+     *          TypedColumn<string_view>, returning the same type for all three
+     * @return What f returns
+     */
+    template <typename F>
+    decltype(auto) visit(F&& f) const;
+
+    /**
+     * @brief Converts the column to another dtype.
+     *
+     * @param new_dtype The target dtype ("int", "float" or "string")
+     * @return A new column holding the converted values; missing values stay missing
+     * @throws invalid_argument If new_dtype is unknown, or a string value cannot be parsed as the target type
+     * @note Float values are truncated when converted to int; NaN, infinite and out-of-range values become missing
+     */
+    Column astype(const string& new_dtype) const {
+        const Buffers& store = data();
+        if (new_dtype != "int" && new_dtype != "float" && new_dtype != "string") {
+            throw invalid_argument("Invalid type: Column::astype() expects `dtype` to be int, float or string");
+        }
+        if (new_dtype == dtype) {
+            return *this;
+        }
+
+        Column result;
+        result.name = name;
+        result.dtype = new_dtype;
+        result.reserve(size());
+        if (new_dtype == "string") {
+            for (size_t i = 0; i < size(); i++) {
+                if (is_na(i)) {
+                    result.append_na();
+                } else {
+                    result.append(at(i));
+                }
+            }
+        } else if (dtype == "string") {
+            for (size_t i = 0; i < size(); i++) {
+                int64_t int_value;
+                double float_value;
+                string_view value = str_at(i);
+                if (is_na(i)) {
+                    result.append_na();
+                } else if (new_dtype == "int" && parse_int(value, int_value)) {
+                    result.append(int_value);
+                } else if (new_dtype == "float" && parse_float(value, float_value)) {
+                    result.append(float_value);
+                } else {
+                    throw invalid_argument("Invalid value: Column::astype() cannot convert '" + string(value) + "' to " + new_dtype);
+                }
+            }
+        } else if (new_dtype == "float") {
+            Buffers& converted = result.edit();
+            for (size_t i = 0; i < size(); i++) {
+                converted.float_data.push_back(static_cast<double>(store.int_data[i]));
+            }
+            converted.validity = store.validity;
+        } else {
+            for (size_t i = 0; i < size(); i++) {
+                // NaN, infinite and out-of-range values have no int64 representation
+                if (is_na(i) || !(store.float_data[i] >= -9.2233720368547758e18 && store.float_data[i] < 9.2233720368547758e18)) {
+                    result.append_na();
+                } else {
+                    result.append(static_cast<int64_t>(store.float_data[i]));
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Appends all elements of another column of the same dtype.
+     *
+     * @param other The column to append; its buffers are moved from
+     * @throws invalid_argument If the columns have different dtypes
+     * @note If both columns are dictionary-encoded their dictionaries are merged, otherwise
+     *       the result is plain
+     */
+    void concat(Column&& other) {
+        if (other.dtype != dtype) {
+            throw invalid_argument("Invalid type: Column::concat() expects both columns to have the same dtype");
+        }
+        if (data().encoded && other.data().encoded) {
+            const Buffers& src = other.data();
+            vector<uint32_t> remap(src.dict.size());
+            for (size_t code = 0; code < src.dict.size(); code++) {
+                remap[code] = intern(src.dict[code]);
+            }
+            Buffers& store = edit();
+            store.dict_codes.reserve(store.dict_codes.size() + src.dict_codes.size());
+            for (size_t idx = 0; idx < src.dict_codes.size(); idx++) {
+                store.dict_codes.push_back(src.validity.get(idx) ? remap[src.dict_codes[idx]] : 0);
+            }
+            store.validity.append(src.validity);
+            return;
+        }
+        decode();
+        other.decode();
+        const Buffers& src = other.data();
+        Buffers& store = edit();
+        store.int_data.insert(store.int_data.end(), src.int_data.begin(), src.int_data.end());
+        store.float_data.insert(store.float_data.end(), src.float_data.begin(), src.float_data.end());
+        store.str_data.append(src.str_data);
+        store.validity.append(src.validity);
+    }
+
+    /**
+     * @brief Gathers the elements at the given indices into a new column.
+     *
+     * @param indices Row indices to take, in output order; Column::npos yields a missing value
+     * @return A new column with the same name and dtype holding the selected elements
+     */
+    Column take(const vector<size_t>& indices) const {
+        const Buffers& store = data();
+        Column result;
+        result.name = name;
+        result.dtype = dtype;
+        Buffers& taken = result.edit();
+        taken.validity.reserve(indices.size());
+        if (dtype == "int") {
+            taken.int_data = gather(store.int_data, indices);
+        } else if (dtype == "float") {
+            taken.float_data = gather(store.float_data, indices);
+        } else if (store.encoded) {
+            taken.encoded = true;
+            taken.dict = store.dict;
+            taken.dict_index = store.dict_index;
+            taken.dict_codes = gather(store.dict_codes, indices);
+        } else {
+            taken.str_data = store.str_data.take(indices, npos);
+        }
+        for (size_t idx : indices) {
+            taken.validity.push_back(idx != npos && store.validity.get(idx));
+        }
+        return result;
+    }
+
+    /**
+     * @brief Prints the column data with optional row limiting and tail functionality.
+     *
+     * @param rows_cnt Number of rows to print (0 = print all rows)
+     * @param is_tail If true, prints the last N rows instead of first N rows
+     */
+    void print(int rows_cnt = 0, bool is_tail = false) const {
+        if (size() == 0) {
+            return;
+        }
+
+        if (rows_cnt == 0) {
+            rows_cnt = size()-1;
+        }
+
+        cout << name << endl;
+
+        for(size_t i = 0; i < name.length(); i++) {
+            cout << '-';
+        }
+
+        cout << endl;
+
+        if (is_tail) {
+            for(size_t idx = size()-rows_cnt; idx < size(); idx++) {
+                cout << at(idx) << endl;
+            }
+        } else {
+            for(int idx = 0; idx < rows_cnt; idx++) {
+                cout << at(idx) << endl;
+            }
+        }
+
+        cout << "\nPrinted: " << rows_cnt << " rows\n";
+    }
+
+    /**
+     * @brief Displays the first N rows of the column.
+     *
+     * @param rows_cnt Number of rows to display from the beginning (default: 5)
+     */
+    void head(int rows_cnt = 5) const {
+        print(rows_cnt);
+    }
+
+    /**
+     * @brief Displays the last N rows of the column.
+     *
+     * @param rows_cnt Number of rows to display from the end (default: 5)
+     */
+    void tail(int rows_cnt = 5) const {
+        print(rows_cnt, true);
+    }
+
+    /**
+     * @brief Counts the non-missing values in the column.
+     *
+     * @return Number of values that are present (NaN counts as missing in float columns)
+     */
+    size_t count() const {
+        if (dtype == "string") {
+            return data().validity.count();
+        }
+        return stats_of(false).count;
+    }
+
+    /**
+     * @brief Computes count, sum, mean, min, max and variance of the column in one pass.
+     *
+     * @param mode How the sum is accumulated; see sum()
+     * @return The column's summary statistics
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Empty/missing values are excluded from the calculation
+     */
+    ColumnStats stats(SumMode mode = SumMode::fast) const {
+        if (dtype == "int" || dtype == "float") {
+            return stats_of(true, mode);
+        }
+
+        throw invalid_argument("Invalid type: Column::stats() expects `dtype` to be int or float");
+    }
+
+    /**
+     * @brief Calculates the arithmetic mean of numeric column data.
+     *
+     * @param mode SumMode::fast (default) or SumMode::precise for compensated summation
+     * @return The mean value as a double
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Empty/missing values are excluded from the calculation
+     */
+    double mean(SumMode mode = SumMode::fast) const {
+        if (dtype == "int" || dtype == "float") {
+            return stats_of(false, mode).mean();
+        }
+
+        throw invalid_argument("Invalid type: Column::mean() expects `dtype` to be int or float");
+    }
+
+    /**
+     * @brief Calculates the sum of the column data.
+     *
+     * Both modes run over several lanes (and threads on long columns). SumMode::precise
+     * also tracks each lane's rounding error, which keeps the result accurate on very
+     * long columns or values of mixed magnitude at roughly twice the cost.
+     *
+     * @param mode SumMode::fast (default) or SumMode::precise for compensated summation
+     * @return The sum value as a double
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Empty/missing values are excluded from the calculation
+     */
+    double sum(SumMode mode = SumMode::fast) const {
+        if (dtype == "int" || dtype == "float") {
+            return stats_of(false, mode).sum;
+        }
+
+        throw invalid_argument("Invalid type: Column::sum() expects `dtype` to be int or float");
+    }
+
+    /**
+     * @brief Calculates the variance of numeric column data.
+     *
+     * @param ddof Delta degrees of freedom; the divisor is count - ddof (default: 1)
+     * @return The variance as a double (NaN if there are not more than ddof values)
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Empty/missing values are excluded from the calculation
+     */
+    double var(size_t ddof = 1) const {
+        if (dtype == "int" || dtype == "float") {
+            return stats_of(true).var(ddof);
+        }
+
+        throw invalid_argument("Invalid type: Column::var() expects `dtype` to be int or float");
+    }
+
+    /**
+     * @brief Calculates the standard deviation of numeric column data.
+     *
+     * @param ddof Delta degrees of freedom; the divisor is count - ddof (default: 1)
+     * @return The standard deviation as a double (NaN if there are not more than ddof values)
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Empty/missing values are excluded from the calculation
+     */
+    double std(size_t ddof = 1) const {
+        if (dtype == "int" || dtype == "float") {
+            return stats_of(true).std(ddof);
+        }
+
+        throw invalid_argument("Invalid type: Column::std() expects `dtype` to be int or float");
+    }
+
+    /**
+     * @brief Returns a sorted copy of the column data in ascending order.
+     *
+     * @return Vector of strings containing sorted numeric values
+     * @throws invalid_argument If the column dtype is "string"
+     * @note The original column data remains unchanged
+     * @note Missing values are not included in the result
+     */
+    vector<string> sorted() const {
+        if (dtype == "string") {
+            throw invalid_argument("Invalid type: Column::Sorted() expects `dtype` to be int or float");
+        }
+        vector<string> result;
+        visit_numeric([&](const auto& values) {
+            using T = typename decay_t<decltype(values)>::value_type;
+            vector<T> present;
+            const Bitmap& valid = data().validity;
+            for (size_t i = 0; i < values.size(); i++) {
+                if (valid.get(i)) {
+                    present.push_back(values[i]);
+                }
+            }
+            std::sort(present.begin(), present.end());
+            for (T x : present) {
+                if constexpr (is_integral_v<T>) {
+                    result.push_back(to_string(x));
+                } else {
+                    result.push_back(format_float(x));
+                }
+            }
+        });
+
+        return result;
+    }
+
+    /**
+     * @brief Returns the distinct values of the column, in order of first appearance.
+     *
+     * @return A column of the same name and dtype; missing values and NaN are left out
+     * @note One pass over the rows with an open-addressing hash table (a dictionary-encoded
+     *       column counts its codes instead); -0.0 and 0.0 are the same value
+     */
+    Column unique() const;
+
+    /**
+     * @brief Returns the number of distinct values, missing values and NaN excluded.
+     */
+    size_t nunique() const;
+
+    /**
+     * @brief Estimates nunique() with a HyperLogLog sketch, in constant memory.
+     *
+     * @return The estimate, with a standard error of about 0.8% (see HyperLogLog)
+     * @note Large columns are sketched in parallel tasks whose sketches are merged
+     */
+    size_t nunique_approx() const;
+
+    /**
+     * @brief Counts the rows holding each distinct value.
+     *
+     * @return A DataFrame with the distinct values (a column named like this one, same
+     *         dtype) and their number of rows ("count", int, or "count_count" if this
+     *         column is named "count"), most frequent first; ties keep the order of first
+     *         appearance, and missing values and NaN are not counted
+     */
+    DataFrame value_counts() const;
+
+    /**
+     * @brief Returns the q-quantile of the present values, interpolating linearly between
+     *        the two closest ranks (as pandas does).
+     *
+     * Found by selection (nth_element), in O(n) on a copy of the values, without sorting;
+     * a column known to be sorted without missing values reads it directly.
+     *
+     * @param q The quantile, from 0 (min) to 1 (max)
+     * @return The quantile, or NaN if there are no present values (NaN values are skipped)
+     * @throws invalid_argument If the column dtype is "string" or q is not in [0, 1]
+     */
+    double quantile(double q) const;
+
+    /**
+     * @brief Returns several quantiles at once, selecting from one copy of the values.
+     *
+     * @param qs The quantiles, each from 0 to 1, in any order
+     * @return One result per entry of qs, in the same order
+     * @throws invalid_argument If the column dtype is "string" or a q is not in [0, 1]
+     */
+    vector<double> quantile(const vector<double>& qs) const;
+
+    /**
+     * @brief Returns quantile(0.5).
+     */
+    double median() const;
+
+    /**
+     * @brief Finds the minimum value in the column.
+     *
+     * @return The minimum value as a double (NaN if the column has no values)
+     * @throws invalid_argument If the column dtype is "string"
+     */
+    double min() const {
+        if (dtype == "string") {
+            throw invalid_argument("Invalid type: Column::min() expects `dtype` to be int or float");
+        }
+        return stats_of(false).min;
+    }
+
+    /**
+     * @brief Finds the maximum value in the column.
+     *
+     * @return The maximum value as a double (NaN if the column has no values)
+     * @throws invalid_argument If the column dtype is "string"
+     */
+    double max() const {
+        if (dtype == "string") {
+            throw invalid_argument("Invalid type: Column::max() expects `dtype` to be int or float");
+        }
+        return stats_of(false).max;
+    }
+
+    /**
+     * @brief Returns the bytes of memory the column's buffers hold.
+     *
+     * Counts the allocated capacity of the values, validity bitmap, string bytes and
+     * offsets, the dictionary and its index (heap strings and hash nodes included,
+     * the nodes estimated) and any cached zone map.
+     *
+     * @return The footprint in bytes; columns sharing their buffers (see the copy
+     *         constructor) each report the whole footprint
+     */
+    size_t memory_usage() const {
+        const Buffers& store = data();
+        auto heap_bytes = [](const string& value) {
+            return value.capacity() > string().capacity() ? value.capacity() + 1 : 0;
+        };
+        size_t bytes = store.int_data.capacity() * sizeof(int64_t)
+            + store.float_data.capacity() * sizeof(double)
+            + store.str_data.char_data().capacity()
+            + store.str_data.offset_data().capacity() * sizeof(uint64_t)
+            + store.dict_codes.capacity() * sizeof(uint32_t)
+            + store.validity.data().capacity() * sizeof(uint64_t)
+            + store.dict.capacity() * sizeof(string)
+            + store.dict_index.bucket_count() * sizeof(void*);
+        for (const string& value : store.dict) {
+            bytes += heap_bytes(value);
+        }
+        for (const auto& [value, code] : store.dict_index) {
+            bytes += sizeof(pair<const string, uint32_t>) + 2 * sizeof(void*) + heap_bytes(value);
+        }
+        return bytes + store.summary.memory_usage();
+    }
+
+    /**
+     * @brief Checks whether the present values of the column are in ascending order.
+     *
+     * The answer is cached with the column's statistics, so asking again is O(1)
+     * until the column is modified.
+     *
+     * @return True if no present value is smaller than the one before it (missing
+     *         values and NaN are skipped; strings compare bytewise)
+     */
+    bool is_sorted() const {
+        const Buffers& store = data();
+        const SummaryCache& summary = store.summary;
+        {
+            lock_guard<mutex> guard(summary.lock);
+            if (summary.sorted >= 0) {
+                return summary.sorted;
+            }
+        }
+        // scanned without the lock, like stats_of()
+        bool result = false;
+        if (dtype == "string") {
+            result = ascending([&](size_t row) { return str_at(row); });
+        } else {
+            visit_numeric([&](const auto& values) {
+                result = ascending([&](size_t row) { return values[row]; });
+            });
+        }
+        lock_guard<mutex> guard(summary.lock);
+        if (summary.sorted < 0) {
+            summary.sorted = result;
+        }
+        return summary.sorted;
+    }
+
+    /**
+     * @brief Fills missing (empty) values in the column with a specified value.
+     *
+     * @tparam T The type of the fill value (int, double, or string)
+     * @param x The value to use for filling missing entries
+     * @throws invalid_argument If a string value is used to fill an int or float column
+     * @note Numeric values are truncated for int columns and converted to their string
+     *       representation for string columns
+     */
+    template <typename T>
+    void fillna(const T& x) {
+        if (data().validity.count() == size()) {
+            return;
+        }
+        Buffers& store = edit();
+        if constexpr (is_arithmetic_v<T>) {
+            if (dtype == "int") {
+                fill_missing(store.int_data, static_cast<int64_t>(x));
+            } else if (dtype == "float") {
+                fill_missing(store.float_data, static_cast<double>(x));
+            } else {
+                fill_missing_str(to_string(x));
+            }
+        } else {
+            if (dtype != "string") {
+                throw invalid_argument("Invalid type: Column::fillna() expects a numeric value for int or float columns");
+            }
+            fill_missing_str(string(x));
+        }
+        store.validity = Bitmap(size(), true);
+    }
+
+    /**
+     * @brief Equality comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that equals the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator==(const double& key) const {
+        return compare_numeric<CmpOp::eq>(key);
+    }
+
+    /**
+     * @brief Inequality comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that is not equal to the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator!=(const double& key) const {
+        return compare_numeric<CmpOp::ne>(key);
+    }
+
+    /**
+     * @brief Less-than comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that is less than the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator<(const double& key) const {
+        return compare_numeric<CmpOp::lt>(key);
+    }
+
+    /**
+     * @brief Greater-than comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that is greater than the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator>(const double& key) const {
+        return compare_numeric<CmpOp::gt>(key);
+    }
+
+    /**
+     * @brief Less-than-or-equal comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that is less than or equal to the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator<=(const double& key) const {
+        return compare_numeric<CmpOp::le>(key);
+    }
+
+    /**
+     * @brief Greater-than-or-equal comparison operator for numeric columns.
+     *
+     * @param key The numeric value to compare against
+     * @return Bitmap with a bit set for each element that is greater than or equal to the key
+     * @throws runtime_error If the column dtype is "string"
+     * @note Missing values never match
+     */
+    Bitmap operator>=(const double& key) const {
+        return compare_numeric<CmpOp::ge>(key);
+    }
+
+    /**
+     * @brief Equality comparison operator for string columns.
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that equals the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator==(const string& key) const {
+        return compare_string<CmpOp::eq>(key);
+    }
+
+    /**
+     * @brief Inequality comparison operator for string columns.
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that is not equal to the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator!=(const string& key) const {
+        return compare_string<CmpOp::ne>(key);
+    }
+
+    /**
+     * @brief Less-than comparison operator for string columns (lexicographic order).
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that is lexicographically less than the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator<(const string& key) const {
+        return compare_string<CmpOp::lt>(key);
+    }
+
+    /**
+     * @brief Greater-than comparison operator for string columns (lexicographic order).
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that is lexicographically greater than the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator>(const string& key) const {
+        return compare_string<CmpOp::gt>(key);
+    }
+
+    /**
+     * @brief Less-than-or-equal comparison operator for string columns (lexicographic order).
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that is lexicographically less than or equal to the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator<=(const string& key) const {
+        return compare_string<CmpOp::le>(key);
+    }
+
+    /**
+     * @brief Greater-than-or-equal comparison operator for string columns (lexicographic order).
+     *
+     * @param key The string value to compare against
+     * @return Bitmap with a bit set for each element that is lexicographically greater than or equal to the key
+     * @throws runtime_error If the column dtype is "float" or "int"
+     * @note Missing values never match
+     */
+    Bitmap operator>=(const string& key) const {
+        return compare_string<CmpOp::ge>(key);
+    }
+
+    /**
+     * @brief Element-wise arithmetic with another column of the same length, or a scalar.
+     *
+     * Runs over the typed buffers a block at a time (see ColumnProgram). A row is missing
+     * in the result if it is missing in either operand. int op int (or an integer scalar)
+     * stays "int" for +, - and *, wrapping around on overflow; / and anything involving a
+     * float gives "float", with IEEE results for division by zero. Chains such as
+     * `(a * b + c) / d` make one temporary column per operator; DataFrame::eval() fuses
+     * them into a single pass instead.
+     *
+     * @return A new column named after the left column operand
+     * @throws invalid_argument If a column is not "int" or "float", or the lengths differ
+     */
+    Column operator+(const Column& other) const;
+    Column operator-(const Column& other) const;
+    Column operator*(const Column& other) const;
+    Column operator/(const Column& other) const;
+    Column operator+(Scalar x) const;
+    Column operator-(Scalar x) const;
+    Column operator*(Scalar x) const;
+    Column operator/(Scalar x) const;
+    friend Column operator+(Scalar x, const Column& col);
+    friend Column operator-(Scalar x, const Column& col);
+    friend Column operator*(Scalar x, const Column& col);
+    friend Column operator/(Scalar x, const Column& col);
+    Column operator-() const;
+
+    /**
+     * @brief Element-wise math functions; abs() keeps an "int" column "int", the others give "float".
+     *
+     * @throws invalid_argument If the column dtype is not "int" or "float"
+     * @note Missing values stay missing; sqrt and log of negative values are NaN
+     */
+    Column abs() const;
+    Column sqrt() const;
+    Column log() const;
+    Column exp() const;
+
+    /**
+     * @brief Limits the values to [lower, upper].
+     *
+     * @param lower Values below it are replaced by it
+     * @param upper Values above it are replaced by it
+     * @return A new column; "int" if the column and both bounds are integers, else "float"
+     * @throws invalid_argument If the column dtype is not "int" or "float", or lower > upper
+     * @note Missing values and NaN stay as they are
+     */
+    Column clip(Scalar lower, Scalar upper) const;
+
+    /**
+     * @brief Keeps the values where cond is set and makes the others missing.
+     *
+     * @param cond One bit per row, e.g. a comparison of this or another column
+     * @return A new column of the same dtype
+     * @throws invalid_argument If cond does not have one bit per row
+     */
+    Column where(const Bitmap& cond) const;
+
+    /**
+     * @brief Keeps the values where cond is set and takes the others from other.
+     *
+     * @param cond One bit per row, e.g. a comparison of this or another column
+     * @param other A scalar, or a column of the same length read row by row (its missing
+     *              values stay missing)
+     * @return A new column; "int" if both sides are integers, else "float"
+     * @throws invalid_argument If a column is not "int" or "float", or the lengths differ
+     */
+    Column where(const Bitmap& cond, Scalar other) const;
+    Column where(const Bitmap& cond, const Column& other) const;
+
+private:
+    friend class ColumnProgram;
+    template <typename T>
+    friend class TypedColumn;
+
+    Column arithmetic(ArithOp op, const Column& other) const;
+    Column arithmetic(ArithOp op, Scalar x, bool reversed = false) const;
+    Column math(MathFn fn) const;
+
+    /**
+     * @brief Numbers the distinct present values (NaN excluded) in order of first appearance.
+     *
+     * @param first_rows If set, receives the first row holding each value
+     * @return The number of rows holding each value, indexed by its number
+     */
+    vector<size_t> count_distinct(vector<size_t>* first_rows) const;
+
+    /**
+     * @brief Calls f(row) for every present row, in order.
+     */
+    template <typename F>
+    void each_present(F&& f) const {
+        const vector<uint64_t>& words = data().validity.data();
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+                f(w * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    /**
+     * @brief Summary statistics of a column's buffers, computed lazily and reused until they change.
+     *
+     * Lives in the Buffers so copies sharing them share the results; edit() clears it, so
+     * every mutation drops it. Copying the buffers starts an empty cache.
+     */
+    struct SummaryCache {
+        mutable mutex lock; // columns sharing the buffers may be reduced from several threads
+        mutable optional<ColumnStats> stats[2]; // one per SumMode
+        mutable bool moments[2] = {}; // whether stats[mode] includes m2
+        mutable int sorted = -1; // is_sorted(), or -1 if not computed yet
+        mutable optional<ZoneMap<int64_t>> int_zones;
+        mutable optional<ZoneMap<double>> float_zones;
+
+        SummaryCache() = default;
+        SummaryCache(const SummaryCache&) {}
+        SummaryCache& operator=(const SummaryCache&) {
+            clear();
+            return *this;
+        }
+
+        void clear() {
+            stats[0].reset();
+            stats[1].reset();
+            sorted = -1;
+            int_zones.reset();
+            float_zones.reset();
+        }
+
+        size_t memory_usage() const {
+            lock_guard<mutex> guard(lock);
+            size_t bytes = 0;
+            if (int_zones) {
+                bytes += (int_zones->min.capacity() + int_zones->max.capacity()) * sizeof(int64_t);
+            }
+            if (float_zones) {
+                bytes += (float_zones->min.capacity() + float_zones->max.capacity()) * sizeof(double);
+            }
+            return bytes;
+        }
+
+        template <typename T>
+        optional<ZoneMap<T>>& zones() const {
+            if constexpr (is_same_v<T, int64_t>) {
+                return int_zones;
+            } else {
+                return float_zones;
+            }
+        }
+    };
+
+    struct Buffers {
+        vector<int64_t> int_data; // values of an "int" column
+        vector<double> float_data; // values of a "float" column
+        StringBuffer str_data; // values of a plain "string" column
+        bool encoded = false; // string column stored as dict + dict_codes instead of str_data
+        vector<string> dict; // distinct values of an encoded column
+        vector<uint32_t> dict_codes; // per row index into dict
+        unordered_map<string, uint32_t> dict_index; // value -> code
+        Bitmap validity; // bit i is cleared when element i is missing
+        SummaryCache summary; // statistics of the values above, computed on first use
+    };
+
+    // shared by the copies of a column until one of them is modified (null while empty)
+    shared_ptr<Buffers> buffers;
+
+    const Buffers& data() const {
+        static const Buffers none;
+        return buffers ? *buffers : none;
+    }
+
+    /**
+     * @brief Returns the buffers for writing, first copying them if another column shares them.
+     */
+    Buffers& edit() {
+        if (!buffers) {
+            LP_PROFILE_ALLOCATION();
+            buffers = make_shared<Buffers>();
+        } else if (buffers.use_count() > 1) {
+            LP_PROFILE_ALLOCATION();
+            buffers = make_shared<Buffers>(*buffers);
+        } else {
+            // pairs with the release of the last other owner, which may have read the buffers
+            atomic_thread_fence(memory_order_acquire);
+            buffers->summary.clear();
+        }
+        return *buffers;
+    }
+
+    /**
+     * @brief Returns the code of value in the dictionary, adding it if it is new.
+     */
+    uint32_t intern(string_view value) {
+        Buffers& store = edit();
+        auto [it, inserted] = store.dict_index.try_emplace(string(value), static_cast<uint32_t>(store.dict.size()));
+        if (inserted) {
+            store.dict.emplace_back(value);
+        }
+        return it->second;
+    }
+
+    void clear_dict() {
+        Buffers& store = edit();
+        vector<string>().swap(store.dict);
+        unordered_map<string, uint32_t>().swap(store.dict_index);
+    }
+
+    template <typename S>
+    void append_str(const S& x) {
+        Buffers& store = edit();
+        if (store.encoded) {
+            store.dict_codes.push_back(intern(x));
+        } else {
+            store.str_data.push_back(string_view(x));
+        }
+    }
+
+    void fill_missing_str(const string& x) {
+        Buffers& store = edit();
+        if (store.encoded) {
+            uint32_t code = intern(x);
+            for (size_t i = 0; i < store.dict_codes.size(); i++) {
+                if (!store.validity.get(i)) {
+                    store.dict_codes[i] = code;
+                }
+            }
+        } else {
+            StringBuffer filled;
+            filled.reserve(store.str_data.size(), store.str_data.char_data().size());
+            for (size_t i = 0; i < store.str_data.size(); i++) {
+                filled.push_back(store.validity.get(i) ? store.str_data[i] : string_view(x));
+            }
+            store.str_data = std::move(filled);
+        }
+    }
+
+    /**
+     * @brief Calls f with the typed buffer of a numeric column.
+     *
+     * The dtype is resolved once per call, so f runs its loop over native values.
+     */
+    template <typename F>
+    void visit_numeric(F&& f) const {
+        const Buffers& store = data();
+        if (dtype == "int") {
+            f(store.int_data);
+        } else {
+            f(store.float_data);
+        }
+    }
+
+    /**
+     * @brief Rewrites `v op key` for int64 values v as `v op bound`.
+     *
+     * Int columns are then compared as integers, without converting each value to double.
+     *
+     * @return -1 if bound was set, otherwise the constant result (0 or 1) of the comparison
+     */
+    template <CmpOp op>
+    static int int_bound(double key, int64_t& bound) {
+        if (std::isnan(key)) {
+            return op == CmpOp::ne ? 1 : 0;
+        }
+        double b;
+        if constexpr (op == CmpOp::eq || op == CmpOp::ne) {
+            if (std::floor(key) != key) {
+                return op == CmpOp::ne ? 1 : 0;
+            }
+            b = key;
+        } else if constexpr (op == CmpOp::lt || op == CmpOp::ge) {
+            b = std::ceil(key);
+        } else {
+            b = std::floor(key);
+        }
+
+        constexpr double limit = 9223372036854775808.0; // 2^63
+        if (b >= limit) {
+            return op == CmpOp::lt || op == CmpOp::le || op == CmpOp::ne ? 1 : 0;
+        }
+        if (b < -limit) {
+            return op == CmpOp::gt || op == CmpOp::ge || op == CmpOp::ne ? 1 : 0;
+        }
+        bound = static_cast<int64_t>(b);
+        return -1;
+    }
+
+    template <typename Get>
+    bool ascending(Get value_at) const {
+        const Bitmap& valid = data().validity;
+        bool seen = false;
+        decltype(value_at(0)) last{};
+        for (size_t row = 0; row < size(); row++) {
+            auto value = value_at(row);
+            if (!valid.get(row) || value != value) { // NaN counts as missing
+                continue;
+            }
+            if (seen && value < last) {
+                return false;
+            }
+            last = value;
+            seen = true;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the cached statistics of the column, reducing it first if they are missing.
+     *
+     * A reduction with moments also settles is_sorted() in the same pass, so describe()
+     * reads each column once.
+     *
+     * @note The cache lock is not held while reducing: the reduction runs on the thread
+     *       pool, whose threads help with other jobs while they wait, and one of those
+     *       may reduce the same buffers. Concurrent callers may both reduce; the first to
+     *       finish publishes its result.
+     */
+    ColumnStats stats_of(bool moments, SumMode mode = SumMode::fast) const {
+        const Buffers& store = data();
+        const SummaryCache& summary = store.summary;
+        size_t slot = mode == SumMode::precise;
+        bool check_order;
+        {
+            lock_guard<mutex> guard(summary.lock);
+            if (summary.stats[slot] && (!moments || summary.moments[slot])) {
+                return *summary.stats[slot];
+            }
+            check_order = moments && summary.sorted < 0;
+        }
+        ColumnStats result;
+        bool ascending = false;
+        visit_numeric([&](const auto& values) {
+            result = reduce_column(values, store.validity, moments, mode, check_order ? &ascending : nullptr);
+        });
+        lock_guard<mutex> guard(summary.lock);
+        if (!summary.stats[slot] || (moments && !summary.moments[slot])) {
+            summary.stats[slot] = result;
+            summary.moments[slot] = moments;
+        }
+        if (check_order && summary.sorted < 0) {
+            summary.sorted = ascending;
+        }
+        return *summary.stats[slot];
+    }
+
+    /**
+     * @brief Sets the bits of mask where `values[i] op key`, scanning only the blocks it must.
+     *
+     * Blocks whose zone map bounds decide the comparison are skipped or set whole;
+     * a sorted column without missing values is answered by binary search. Bits of
+     * missing rows are left for the caller to clear.
+     */
+    template <CmpOp op, typename T>
+    void compare_blocks(const vector<T>& values, const T& key, Bitmap& mask) const {
+        constexpr size_t block_rows = ZoneMap<T>::block_rows;
+        size_t n = values.size();
+        uint64_t* words = mask.data().data();
+        if (n <= block_rows || key != key) {
+            compare_kernel<op>(values.data(), n, key, words);
+            return;
+        }
+
+        const ZoneMap<T>& zones = zone_map<T>();
+        if (zones.sorted && zones.complete) {
+            // the matching rows are one range, or the two around it for !=
+            size_t lo = lower_bound(values.begin(), values.end(), key) - values.begin();
+            size_t hi = upper_bound(values.begin() + lo, values.end(), key) - values.begin();
+            if constexpr (op == CmpOp::eq) {
+                mask.set_range(lo, hi);
+            } else if constexpr (op == CmpOp::ne) {
+                mask.set_range(0, lo);
+                mask.set_range(hi, n);
+            } else if constexpr (op == CmpOp::lt || op == CmpOp::le) {
+                mask.set_range(0, op == CmpOp::lt ? lo : hi);
+            } else {
+                mask.set_range(op == CmpOp::gt ? hi : lo, n);
+            }
+            return;
+        }
+
+        size_t pending = 0; // first block of the run waiting to be scanned
+        for (size_t b = 0; b <= zones.num_blocks(); b++) {
+            int match = b < zones.num_blocks() ? zones.template classify<op>(b, key) : 0;
+            if (match < 0) {
+                continue;
+            }
+            size_t begin = pending * block_rows;
+            size_t end = std::min(n, b * block_rows);
+            if (begin < end) {
+                compare_kernel<op>(values.data() + begin, end - begin, key, words + begin / 64);
+            }
+            if (match == 1) {
+                mask.set_range(b * block_rows, std::min(n, (b + 1) * block_rows));
+            }
+            pending = b + 1;
+        }
+    }
+
+    template <CmpOp op>
+    Bitmap compare_numeric(double key) const {
+        LP_PROFILE_SCOPE("compare");
+        LP_PROFILE_ROWS(size(), size() * 8);
+        const Buffers& store = data();
+        if (dtype == "string") {
+           throw runtime_error("Error: Invalid comparison");
+        }
+
+        Bitmap mask(size());
+        if (dtype == "float") {
+            compare_blocks<op>(store.float_data, key, mask);
+        } else {
+            int64_t bound = 0;
+            int constant = int_bound<op>(key, bound);
+            if (constant < 0) {
+                compare_blocks<op>(store.int_data, bound, mask);
+            } else if (constant == 1) {
+                mask = Bitmap(size(), true);
+            }
+        }
+        // missing values never match
+        mask &= store.validity;
+        return mask;
+    }
+
+    template <CmpOp op>
+    Bitmap compare_string(const string& key) const {
+        LP_PROFILE_SCOPE("compare");
+        LP_PROFILE_ROWS(size(), 0);
+        const Buffers& store = data();
+        if (dtype == "float" || dtype == "int") {
+           throw runtime_error("Error: Invalid comparison");
+        }
+
+        Bitmap mask(size());
+        if (!store.encoded) {
+            string_view k = key;
+            uint64_t* words = mask.data().data();
+            for (size_t idx = 0; idx < store.str_data.size(); idx++) {
+                words[idx >> 6] |= uint64_t(compare_values<op>(store.str_data[idx], k)) << (idx & 63);
+            }
+        } else if constexpr (op == CmpOp::eq || op == CmpOp::ne) {
+            // one dictionary lookup, then an integer scan over the codes
+            auto it = store.dict_index.find(key);
+            if (it != store.dict_index.end()) {
+                compare_kernel<op>(store.dict_codes.data(), store.dict_codes.size(), it->second, mask.data().data());
+            } else if (op == CmpOp::ne) {
+                mask = Bitmap(size(), true);
+            }
+        } else {
+            // compare each distinct value once, then look every row's code up
+            vector<uint8_t> hit(store.dict.size());
+            for (size_t code = 0; code < store.dict.size(); code++) {
+                hit[code] = compare_values<op>(store.dict[code], key);
+            }
+            uint64_t* words = mask.data().data();
+            for (size_t idx = 0; idx < store.dict_codes.size(); idx++) {
+                if (store.validity.get(idx) && hit[store.dict_codes[idx]]) {
+                    words[idx >> 6] |= uint64_t(1) << (idx & 63);
+                }
+            }
+        }
+        mask &= store.validity;
+        return mask;
+    }
+
+    template <typename T>
+    void fill_missing(vector<T>& values, const T& x) {
+        const Bitmap& valid = data().validity;
+        for (size_t i = 0; i < values.size(); i++) {
+            if (!valid.get(i)) {
+                values[i] = x;
+            }
+        }
+    }
+
+    template <typename T>
+    static vector<T> gather(const vector<T>& values, const vector<size_t>& indices) {
+        vector<T> result;
+        result.reserve(indices.size());
+        for (size_t idx : indices) {
+            result.push_back(idx == npos ? T() : values[idx]);
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief A numeric column expression compiled into steps that run a block of rows at a time.
+ *
+ * Each step computes one block of values (and validity words) into a small register
+ * before the next step reads it, so an expression like `(a * b + c) / d` reads every
+ * input once and keeps its intermediates in cache instead of materializing a column per
+ * operator. Inputs already in the result's type are read in place, constants are folded
+ * or broadcast without registers, and long inputs are split into ranges of blocks that
+ * run on separate threads. A row is missing in a step if it is missing in any operand
+ * it reads, and missing rows hold 0 in the result like append_na().
+ *
+ * The program computes in int64 only if its result is "int" (every input is an integer
+ * and it uses no / or float-valued function), otherwise in double throughout.
+ * Used by the Column arithmetic operators and by Expr::compute().
+ */
+class ColumnProgram {
+public:
+    static constexpr size_t block_rows = 1024; // 8KB registers
+    static constexpr size_t block_words = block_rows / 64;
+
+    /**
+     * @brief Adds a step reading col, which must outlive run(); returns its index.
+     *
+     * @throws invalid_argument If col is not "int" or "float", or its length differs from earlier inputs
+     */
+    size_t load(const Column& col) {
+        if (col.dtype != "int" && col.dtype != "float") {
+            throw invalid_argument("Invalid type: Column arithmetic expects `dtype` to be int or float");
+        }
+        check_rows(col.size());
+        Step step;
+        step.kind = Step::load;
+        step.col = &col;
+        step.integral = col.dtype == "int";
+        return add(step);
+    }
+
+    size_t constant(Scalar x) {
+        Step step;
+        step.kind = Step::constant;
+        step.value = x;
+        step.integral = x.integral;
+        return add(step);
+    }
+
+    size_t binary(ArithOp op, size_t a, size_t b) {
+        Step step;
+        step.kind = Step::binary;
+        step.op = op;
+        step.a = a;
+        step.b = b;
+        step.integral = steps[a].integral && steps[b].integral && op != ArithOp::div;
+        if (steps[a].kind == Step::constant && steps[b].kind == Step::constant) {
+            // folded once here instead of once per row
+            Scalar x = steps[a].value;
+            Scalar y = steps[b].value;
+            if (step.integral) {
+                return constant(with_arith<int64_t>(op, [&](auto tag) { return arith_value<tag.value>(x.integer, y.integer); }));
+            }
+            return constant(with_arith<double>(op, [&](auto tag) { return arith_value<tag.value>(x.number, y.number); }));
+        }
+        return add(step);
+    }
+
+    size_t unary(MathFn fn, size_t a) {
+        Step step;
+        step.kind = Step::unary;
+        step.fn = fn;
+        step.a = a;
+        step.integral = steps[a].integral && (fn == MathFn::neg || fn == MathFn::abs);
+        if (steps[a].kind == Step::constant) {
+            Scalar x = steps[a].value;
+            if (step.integral) {
+                return constant(with_math<int64_t>(fn, [&](auto tag) { return math_value<tag.value>(x.integer); }));
+            }
+            return constant(with_math<double>(fn, [&](auto tag) { return math_value<tag.value>(x.number); }));
+        }
+        return add(step);
+    }
+
+    /**
+     * @brief Adds a step taking a where mask is set and b elsewhere; mask must outlive run().
+     *
+     * @throws invalid_argument If the mask length differs from the inputs
+     */
+    size_t select(const Bitmap& mask, size_t a, size_t b) {
+        check_rows(mask.size());
+        Step step;
+        step.kind = Step::select;
+        step.mask = &mask;
+        step.a = a;
+        step.b = b;
+        step.integral = steps[a].integral && steps[b].integral;
+        return add(step);
+    }
+
+    /**
+     * @brief Computes step result for every row.
+     *
+     * @param result Index of the step whose values to return
+     * @param name Name of the returned column
+     * @throws invalid_argument If the program reads no column, so has no length
+     */
+    Column run(size_t result, const string& name) const {
+        if (!has_rows) {
+            throw invalid_argument("Invalid argument: a column expression needs at least one column");
+        }
+        Column out;
+        out.name = name;
+        out.dtype = steps[result].integral ? "int" : "float";
+        Column::Buffers& store = out.edit();
+        store.validity = Bitmap(rows);
+        if (steps[result].integral) {
+            store.int_data.resize(rows);
+            execute(result, store.int_data.data(), store.validity);
+        } else {
+            store.float_data.resize(rows);
+            execute(result, store.float_data.data(), store.validity);
+        }
+        return out;
+    }
+
+private:
+    struct Step {
+        enum Kind { load, constant, binary, unary, select };
+
+        Kind kind = load;
+        bool integral = false; // the values are integers, so an "int" program can compute them
+        const Column* col = nullptr; // load
+        Scalar value = 0; // constant
+        ArithOp op = ArithOp::add; // binary
+        MathFn fn = MathFn::neg; // unary
+        const Bitmap* mask = nullptr; // select
+        size_t a = 0, b = 0; // operand steps
+    };
+
+    vector<Step> steps; // in evaluation order: operands come before the steps reading them
+    size_t rows = 0;
+    bool has_rows = false;
+
+    size_t add(const Step& step) {
+        steps.push_back(step);
+        return steps.size() - 1;
+    }
+
+    void check_rows(size_t n) {
+        if (has_rows && n != rows) {
+            throw invalid_argument("Invalid argument: Column arithmetic expects columns of the same length");
+        }
+        rows = n;
+        has_rows = true;
+    }
+
+    // call f with the operator as an integral_constant, skipping the ones T cannot compute
+    template <typename T, typename F>
+    static auto with_arith(ArithOp op, F&& f) -> decltype(f(integral_constant<ArithOp, ArithOp::add>())) {
+        switch (op) {
+        case ArithOp::add: return f(integral_constant<ArithOp, ArithOp::add>());
+        case ArithOp::sub: return f(integral_constant<ArithOp, ArithOp::sub>());
+        case ArithOp::mul: return f(integral_constant<ArithOp, ArithOp::mul>());
+        case ArithOp::min: return f(integral_constant<ArithOp, ArithOp::min>());
+        case ArithOp::max: return f(integral_constant<ArithOp, ArithOp::max>());
+        default:
+            if constexpr (!is_integral_v<T>) {
+                return f(integral_constant<ArithOp, ArithOp::div>());
+            }
+            throw runtime_error("Error: integer program with a division");
+        }
+    }
+
+    template <typename T, typename F>
+    static auto with_math(MathFn fn, F&& f) -> decltype(f(integral_constant<MathFn, MathFn::neg>())) {
+        switch (fn) {
+        case MathFn::neg: return f(integral_constant<MathFn, MathFn::neg>());
+        case MathFn::abs: return f(integral_constant<MathFn, MathFn::abs>());
+        default:
+            if constexpr (!is_integral_v<T>) {
+                switch (fn) {
+                case MathFn::sqrt: return f(integral_constant<MathFn, MathFn::sqrt>());
+                case MathFn::log: return f(integral_constant<MathFn, MathFn::log>());
+                default: return f(integral_constant<MathFn, MathFn::exp>());
+                }
+            }
+            throw runtime_error("Error: integer program with a float-valued function");
+        }
+    }
+
+    template <typename T>
+    static T constant_of(const Step& step) {
+        return step.value.integral ? static_cast<T>(step.value.integer) : static_cast<T>(step.value.number);
+    }
+
+    // a and b are null for constants, whose values are ka and kb
+    template <ArithOp op, typename T>
+    static void binary_kernel(const T* a, T ka, const T* b, T kb, T* out, size_t n) {
+        if (!a) {
+            for (size_t r = 0; r < n; r++) {
+                out[r] = arith_value<op>(ka, b[r]);
+            }
+        } else if (!b) {
+            for (size_t r = 0; r < n; r++) {
+                out[r] = arith_value<op>(a[r], kb);
+            }
+        } else {
+            for (size_t r = 0; r < n; r++) {
+                out[r] = arith_value<op>(a[r], b[r]);
+            }
+        }
+    }
+
+    /**
+     * @brief Runs the steps over every block of rows, writing step result into dest and validity.
+     */
+    template <typename T>
+    void execute(size_t result, T* dest, Bitmap& validity) const {
+        constexpr size_t task_rows = 64 * block_rows;
+        size_t num_tasks = (rows + task_rows - 1) / task_rows;
+        uint64_t* valid_dest = validity.data().data();
+        parallel_for(num_tasks, rows >= parallel_min_rows ? 0 : 1, [&](size_t task) {
+            // registers, and where each step's values and validity are (null: a constant)
+            vector<T> values(steps.size() * block_rows);
+            vector<uint64_t> valid(steps.size() * block_words);
+            vector<const T*> value_of(steps.size());
+            vector<const uint64_t*> valid_of(steps.size());
+
+            size_t task_end = std::min(rows, (task + 1) * task_rows);
+            for (size_t begin = task * task_rows; begin < task_end; begin += block_rows) {
+                size_t n = std::min(block_rows, task_end - begin);
+                size_t words = (n + 63) / 64;
+                T* out_values = dest + begin;
+                uint64_t* out_valid = valid_dest + begin / 64;
+
+                for (size_t i = 0; i < steps.size(); i++) {
+                    const Step& step = steps[i];
+                    T* out = i == result ? out_values : values.data() + i * block_rows;
+                    uint64_t* vout = i == result ? out_valid : valid.data() + i * block_words;
+                    const uint64_t* va = valid_of[step.a];
+                    const uint64_t* vb = valid_of[step.b];
+                    value_of[i] = out;
+                    valid_of[i] = vout;
+                    switch (step.kind) {
+                    case Step::load: {
+                        const Column::Buffers& store = step.col->data();
+                        valid_of[i] = store.validity.data().data() + begin / 64;
+                        if (step.integral == is_integral_v<T>) {
+                            if constexpr (is_integral_v<T>) {
+                                value_of[i] = store.int_data.data() + begin;
+                            } else {
+                                value_of[i] = store.float_data.data() + begin;
+                            }
+                        } else {
+                            const int64_t* src = store.int_data.data() + begin;
+                            for (size_t r = 0; r < n; r++) {
+                                out[r] = static_cast<T>(src[r]);
+                            }
+                        }
+                        break;
+                    }
+                    case Step::constant:
+                        value_of[i] = nullptr;
+                        valid_of[i] = nullptr;
+                        break;
+                    case Step::binary: {
+                        const T* a = value_of[step.a];
+                        const T* b = value_of[step.b];
+                        T ka = a ? T() : constant_of<T>(steps[step.a]);
+                        T kb = b ? T() : constant_of<T>(steps[step.b]);
+                        with_arith<T>(step.op, [&](auto tag) {
+                            binary_kernel<tag.value>(a, ka, b, kb, out, n);
+                        });
+                        if (!va || !vb) {
+                            valid_of[i] = va ? va : vb;
+                        } else {
+                            for (size_t w = 0; w < words; w++) {
+                                vout[w] = va[w] & vb[w];
+                            }
+                        }
+                        break;
+                    }
+                    case Step::unary: {
+                        const T* a = value_of[step.a];
+                        with_math<T>(step.fn, [&](auto tag) {
+                            for (size_t r = 0; r < n; r++) {
+                                out[r] = math_value<tag.value>(a[r]);
+                            }
+                        });
+                        valid_of[i] = va;
+                        break;
+                    }
+                    case Step::select: {
+                        const T* a = value_of[step.a];
+                        const T* b = value_of[step.b];
+                        T ka = a ? T() : constant_of<T>(steps[step.a]);
+                        T kb = b ? T() : constant_of<T>(steps[step.b]);
+                        const uint64_t* mask = step.mask->data().data() + begin / 64;
+                        for (size_t r = 0; r < n; r++) {
+                            bool take_a = (mask[r >> 6] >> (r & 63)) & 1;
+                            out[r] = take_a ? (a ? a[r] : ka) : (b ? b[r] : kb);
+                        }
+                        for (size_t w = 0; w < words; w++) {
+                            vout[w] = (mask[w] & (va ? va[w] : ~uint64_t(0))) | (~mask[w] & (vb ? vb[w] : ~uint64_t(0)));
+                        }
+                        break;
+                    }
+                    }
+                }
+
+                // a result read in place (or a constant) still has to be copied out
+                const T* result_values = value_of[result];
+                const uint64_t* result_valid = valid_of[result];
+                if (!result_values) {
+                    fill(out_values, out_values + n, constant_of<T>(steps[result]));
+                } else if (result_values != out_values) {
+                    copy(result_values, result_values + n, out_values);
+                }
+                if (!result_valid) {
+                    fill(out_valid, out_valid + words, ~uint64_t(0));
+                } else if (result_valid != out_valid) {
+                    copy(result_valid, result_valid + words, out_valid);
+                }
+                uint64_t last_word = n & 63 ? (uint64_t(1) << (n & 63)) - 1 : ~uint64_t(0);
+                out_valid[words - 1] &= last_word;
+                for (size_t w = 0; w < words; w++) {
+                    uint64_t missing = ~out_valid[w] & (w + 1 < words ? ~uint64_t(0) : last_word);
+                    for (; missing != 0; missing &= missing - 1) {
+                        out_values[w * 64 + __builtin_ctzll(missing)] = T();
+                    }
+                }
+            }
+        });
+    }
+};
+
+inline Column Column::arithmetic(ArithOp op, const Column& other) const {
+    ColumnProgram program;
+    size_t a = program.load(*this);
+    size_t b = program.load(other);
+    return program.run(program.binary(op, a, b), name);
+}
+
+inline Column Column::arithmetic(ArithOp op, Scalar x, bool reversed) const {
+    ColumnProgram program;
+    size_t col = program.load(*this);
+    size_t k = program.constant(x);
+    return program.run(reversed ? program.binary(op, k, col) : program.binary(op, col, k), name);
+}
+
+inline Column Column::math(MathFn fn) const {
+    ColumnProgram program;
+    return program.run(program.unary(fn, program.load(*this)), name);
+}
+
+inline Column Column::operator+(const Column& other) const { return arithmetic(ArithOp::add, other); }
+inline Column Column::operator-(const Column& other) const { return arithmetic(ArithOp::sub, other); }
+inline Column Column::operator*(const Column& other) const { return arithmetic(ArithOp::mul, other); }
+inline Column Column::operator/(const Column& other) const { return arithmetic(ArithOp::div, other); }
+inline Column Column::operator+(Scalar x) const { return arithmetic(ArithOp::add, x); }
+inline Column Column::operator-(Scalar x) const { return arithmetic(ArithOp::sub, x); }
+inline Column Column::operator*(Scalar x) const { return arithmetic(ArithOp::mul, x); }
+inline Column Column::operator/(Scalar x) const { return arithmetic(ArithOp::div, x); }
+inline Column operator+(Scalar x, const Column& col) { return col.arithmetic(ArithOp::add, x, true); }
+inline Column operator-(Scalar x, const Column& col) { return col.arithmetic(ArithOp::sub, x, true); }
+inline Column operator*(Scalar x, const Column& col) { return col.arithmetic(ArithOp::mul, x, true); }
+inline Column operator/(Scalar x, const Column& col) { return col.arithmetic(ArithOp::div, x, true); }
+inline Column Column::operator-() const { return math(MathFn::neg); }
+inline Column Column::abs() const { return math(MathFn::abs); }
+inline Column Column::sqrt() const { return math(MathFn::sqrt); }
+inline Column Column::log() const { return math(MathFn::log); }
+inline Column Column::exp() const { return math(MathFn::exp); }
+
+inline Column Column::clip(Scalar lower, Scalar upper) const {
+    if (lower.number > upper.number) {
+        throw invalid_argument("Invalid argument: Column::clip() expects lower <= upper");
+    }
+    ColumnProgram program;
+    size_t col = program.load(*this);
+    size_t low = program.constant(lower);
+    size_t raised = program.binary(ArithOp::max, col, low);
+    size_t high = program.constant(upper);
+    return program.run(program.binary(ArithOp::min, raised, high), name);
+}
+
+inline Column Column::where(const Bitmap& cond) const {
+    if (cond.size() != size()) {
+        throw invalid_argument("Invalid argument: Column::where() expects one mask bit per row");
+    }
+    if (dtype != "int" && dtype != "float") {
+        vector<size_t> rows(size());
+        for (size_t row = 0; row < size(); row++) {
+            rows[row] = cond.get(row) ? row : npos;
+        }
+        return take(rows);
+    }
+    ColumnProgram program;
+    size_t col = program.load(*this);
+    Scalar zero = dtype == "int" ? Scalar(0) : Scalar(0.0);
+    Column result = program.run(program.select(cond, col, program.constant(zero)), name);
+    Buffers& store = result.edit();
+    store.validity &= cond;
+    return result;
+}
+
+inline Column Column::where(const Bitmap& cond, Scalar other) const {
+    ColumnProgram program;
+    size_t col = program.load(*this);
+    return program.run(program.select(cond, col, program.constant(other)), name);
+}
+
+inline Column Column::where(const Bitmap& cond, const Column& other) const {
+    ColumnProgram program;
+    size_t col = program.load(*this);
+    return program.run(program.select(cond, col, program.load(other)), name);
+}
+
+/**
+ * @brief A column whose element type is fixed at compile time.
+ *
+ * Returned by Column::as<T>() and DataFrame::column<T>() for
+ * T = int64_t ("int"), double ("float") or string_view ("string"); any other T fails to
+ * compile. The dtype is checked once when the view is made, and the callables given to
+ * map(), where(), reduce() and for_each() are called on native values in loops the
+ * compiler can inline (and, for numeric columns without missing values, vectorize).
+ *
+ * The view shares the column's buffers (see Column), so it stays valid after the column
+ * is modified or destroyed and keeps showing the values it was made from.
+ */
+template <typename T>
+class TypedColumn {
+    static_assert(is_same_v<T, int64_t> || is_same_v<T, double> || is_same_v<T, string_view>,
+                  "TypedColumn<T> expects T to be int64_t, double or string_view");
+
+public:
+    using value_type = T;
+
+    // dtype of the columns this view accepts
+    static constexpr const char* dtype = is_same_v<T, int64_t> ? "int" : is_same_v<T, double> ? "float" : "string";
+
+    /**
+     * @throws invalid_argument If T does not match the column dtype
+     */
+    explicit TypedColumn(const Column& col) : name(col.name), buffers(col.buffers) {
+        if (col.dtype != dtype) {
+            throw invalid_argument(string("Invalid type: Column::as() expects a ") + dtype + " column, got " + col.dtype);
+        }
+    }
+
+    string name;
+
+    size_t size() const {
+        return store().validity.size();
+    }
+
+    bool is_na(size_t row) const {
+        return !store().validity.get(row);
+    }
+
+    /**
+     * @brief Returns the value at row (0 or an empty string if it is missing).
+     */
+    T operator[](size_t row) const {
+        const Column::Buffers& b = store();
+        if constexpr (is_same_v<T, int64_t>) {
+            return b.int_data[row];
+        } else if constexpr (is_same_v<T, double>) {
+            return b.float_data[row];
+        } else if (b.encoded) {
+            return b.validity.get(row) ? string_view(b.dict[b.dict_codes[row]]) : string_view();
+        } else {
+            return b.str_data[row];
+        }
+    }
+
+    /**
+     * @brief Returns the contiguous values of a numeric column, missing rows included.
+     */
+    const T* values() const {
+        static_assert(!is_same_v<T, string_view>, "TypedColumn<string_view>::values() is not available, use operator[]");
+        if constexpr (is_same_v<T, int64_t>) {
+            return store().int_data.data();
+        } else {
+            return store().float_data.data();
+        }
+    }
+
+    const Bitmap& valid() const {
+        return store().validity;
+    }
+
+    /**
+     * @brief Calls f(row, value) for every present value, in row order.
+     */
+    template <typename F>
+    void for_each(F&& f) const {
+        with_values([&](auto value_at) {
+            each_present([&](size_t row) {
+                f(row, value_at(row));
+            });
+        });
+    }
+
+    /**
+     * @brief Applies f to every present value and returns the results as a new column.
+     *
+     * @param f Callable taking a T; the dtype of the result follows its return type:
+     *          integral (bool included) gives "int", floating-point "float", and
+     *          anything convertible to string_view "string"
+     * @return A column of the same name and size; missing values stay missing
+     */
+    template <typename F>
+    Column map(F&& f) const {
+        using R = decay_t<invoke_result_t<F&, T>>;
+        static_assert(is_arithmetic_v<R> || is_convertible_v<R, string_view>,
+                      "TypedColumn::map() expects f to return a number or a string");
+        const Column::Buffers& b = store();
+        size_t n = size();
+        Column result;
+        result.name = name;
+        result.dtype = is_integral_v<R> ? "int" : is_floating_point_v<R> ? "float" : "string";
+        Column::Buffers& out = result.edit();
+        out.validity = b.validity;
+        if constexpr (is_arithmetic_v<R>) {
+            using Out = conditional_t<is_integral_v<R>, int64_t, double>;
+            vector<Out>& out_values = [&]() -> vector<Out>& {
+                if constexpr (is_integral_v<R>) {
+                    return out.int_data;
+                } else {
+                    return out.float_data;
+                }
+            }();
+            out_values.resize(n);
+            with_values([&](auto value_at) {
+                if (b.validity.count() == n) {
+                    for (size_t row = 0; row < n; row++) {
+                        out_values[row] = static_cast<Out>(f(value_at(row)));
+                    }
+                } else {
+                    each_present([&](size_t row) {
+                        out_values[row] = static_cast<Out>(f(value_at(row)));
+                    });
+                }
+            });
+        } else {
+            out.str_data.reserve(n);
+            with_values([&](auto value_at) {
+                for (size_t row = 0; row < n; row++) {
+                    if (b.validity.get(row)) {
+                        R mapped = f(value_at(row));
+                        out.str_data.push_back(string_view(mapped));
+                    } else {
+                        out.str_data.push_back(string_view());
+                    }
+                }
+            });
+        }
+        return result;
+    }
+
+    /**
+     * @brief Returns the mask of the rows whose value satisfies pred.
+     *
+     * @param pred Callable taking a T and returning a bool
+     * @return One bit per row; missing values never match
+     */
+    template <typename F>
+    Bitmap where(F&& pred) const {
+        const Column::Buffers& b = store();
+        size_t n = size();
+        Bitmap mask(n);
+        uint64_t* words = mask.data().data();
+        with_values([&](auto value_at) {
+            if (b.validity.count() == n) {
+                // a word of results at a time, so numeric predicates run without branches
+                for (size_t begin = 0; begin < n; begin += 64) {
+                    size_t end = std::min(n, begin + 64);
+                    uint64_t word = 0;
+                    for (size_t row = begin; row < end; row++) {
+                        word |= uint64_t(static_cast<bool>(pred(value_at(row)))) << (row - begin);
+                    }
+                    words[begin / 64] = word;
+                }
+            } else {
+                each_present([&](size_t row) {
+                    if (pred(value_at(row))) {
+                        words[row / 64] |= uint64_t(1) << (row % 64);
+                    }
+                });
+            }
+        });
+        return mask;
+    }
+
+    /**
+     * @brief Folds the present values in row order: acc = f(acc, value), starting from init.
+     */
+    template <typename U, typename F>
+    U reduce(U init, F&& f) const {
+        const Column::Buffers& b = store();
+        size_t n = size();
+        U acc = std::move(init);
+        with_values([&](auto value_at) {
+            if (b.validity.count() == n) {
+                for (size_t row = 0; row < n; row++) {
+                    acc = f(std::move(acc), value_at(row));
+                }
+            } else {
+                each_present([&](size_t row) {
+                    acc = f(std::move(acc), value_at(row));
+                });
+            }
+        });
+        return acc;
+    }
+
+private:
+    shared_ptr<Column::Buffers> buffers; // null for an empty column
+
+    const Column::Buffers& store() const {
+        static const Column::Buffers none;
+        return buffers ? *buffers : none;
+    }
+
+    /**
+     * @brief Calls g with a callable returning the value at a present row, chosen once
+     *        for the storage (a string column may be plain or dictionary-encoded).
+     */
+    template <typename G>
+    void with_values(G&& g) const {
+        const Column::Buffers& b = store();
+        if constexpr (is_same_v<T, int64_t>) {
+            const int64_t* v = b.int_data.data();
+            g([v](size_t row) { return v[row]; });
+        } else if constexpr (is_same_v<T, double>) {
+            const double* v = b.float_data.data();
+            g([v](size_t row) { return v[row]; });
+        } else if (b.encoded) {
+            const string* dict = b.dict.data();
+            const uint32_t* codes = b.dict_codes.data();
+            g([dict, codes](size_t row) { return string_view(dict[codes[row]]); });
+        } else {
+            const StringBuffer& strings = b.str_data;
+            g([&strings](size_t row) { return strings[row]; });
+        }
+    }
+
+    template <typename G>
+    void each_present(G&& g) const {
+        const vector<uint64_t>& words = store().validity.data();
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+                g(w * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+};
+
+template <typename T>
+TypedColumn<T> Column::as() const {
+    return TypedColumn<T>(*this);
+}
+
+template <typename F>
+decltype(auto) Column::visit(F&& f) const {
+    if (dtype == "int") {
+        return f(TypedColumn<int64_t>(*this));
+    }
+    if (dtype == "float") {
+        return f(TypedColumn<double>(*this));
+    }
+    return f(TypedColumn<string_view>(*this));
+}
+
+/**
+ * @brief A row predicate built from comparisons of columns with constants.
+ *
+ * `Expr::col("Years") > 30 & Expr::col("City") == "Cairo"` describes a filter without
+ * evaluating it, so a LazyFrame can inspect the columns it reads and push it down into
+ * the file readers. Comparisons combine with &, | and ~ like Bitmap masks and follow the
+ * same rules as the Column operators: missing values never match a comparison.
+ *
+ * Columns and numbers also combine with +, -, *, / and the math functions into
+ * arithmetic expressions, which compute() (or DataFrame::eval()) runs in one fused pass,
+ * and which can be compared like a column: `Expr::col("Price") * Expr::col("Qty") > 100`.
+ */
+class Expr {
+public:
+    /**
+     * @brief Refers to a column by name; compare it with a constant to get a predicate.
+     */
+    static Expr col(const string& name) {
+        auto node = make_shared<Node>();
+        node->kind = Node::column;
+        node->name = name;
+        return Expr(std::move(node));
+    }
+
+    Expr operator==(double key) const { return compare(CmpOp::eq, key, ""); }
+    Expr operator!=(double key) const { return compare(CmpOp::ne, key, ""); }
+    Expr operator<(double key) const { return compare(CmpOp::lt, key, ""); }
+    Expr operator>(double key) const { return compare(CmpOp::gt, key, ""); }
+    Expr operator<=(double key) const { return compare(CmpOp::le, key, ""); }
+    Expr operator>=(double key) const { return compare(CmpOp::ge, key, ""); }
+
+    Expr operator==(const string& key) const { return compare(CmpOp::eq, 0, key, true); }
+    Expr operator!=(const string& key) const { return compare(CmpOp::ne, 0, key, true); }
+    Expr operator<(const string& key) const { return compare(CmpOp::lt, 0, key, true); }
+    Expr operator>(const string& key) const { return compare(CmpOp::gt, 0, key, true); }
+    Expr operator<=(const string& key) const { return compare(CmpOp::le, 0, key, true); }
+    Expr operator>=(const string& key) const { return compare(CmpOp::ge, 0, key, true); }
+
+    friend Expr operator&(const Expr& a, const Expr& b) {
+        return combine(Node::conjunction, a, b);
+    }
+
+    friend Expr operator|(const Expr& a, const Expr& b) {
+        return combine(Node::disjunction, a, b);
+    }
+
+    friend Expr operator~(const Expr& a) {
+        return combine(Node::negation, a, a);
+    }
+
+    friend Expr operator+(const Expr& a, const Expr& b) { return arithmetic(ArithOp::add, a, b); }
+    friend Expr operator-(const Expr& a, const Expr& b) { return arithmetic(ArithOp::sub, a, b); }
+    friend Expr operator*(const Expr& a, const Expr& b) { return arithmetic(ArithOp::mul, a, b); }
+    friend Expr operator/(const Expr& a, const Expr& b) { return arithmetic(ArithOp::div, a, b); }
+    friend Expr operator+(const Expr& a, Scalar x) { return arithmetic(ArithOp::add, a, literal(x)); }
+    friend Expr operator-(const Expr& a, Scalar x) { return arithmetic(ArithOp::sub, a, literal(x)); }
+    friend Expr operator*(const Expr& a, Scalar x) { return arithmetic(ArithOp::mul, a, literal(x)); }
+    friend Expr operator/(const Expr& a, Scalar x) { return arithmetic(ArithOp::div, a, literal(x)); }
+    friend Expr operator+(Scalar x, const Expr& b) { return arithmetic(ArithOp::add, literal(x), b); }
+    friend Expr operator-(Scalar x, const Expr& b) { return arithmetic(ArithOp::sub, literal(x), b); }
+    friend Expr operator*(Scalar x, const Expr& b) { return arithmetic(ArithOp::mul, literal(x), b); }
+    friend Expr operator/(Scalar x, const Expr& b) { return arithmetic(ArithOp::div, literal(x), b); }
+
+    Expr operator-() const { return math(MathFn::neg); }
+    Expr abs() const { return math(MathFn::abs); }
+    Expr sqrt() const { return math(MathFn::sqrt); }
+    Expr log() const { return math(MathFn::log); }
+    Expr exp() const { return math(MathFn::exp); }
+
+    /**
+     * @brief Limits the values to [lower, upper]; see Column::clip().
+     */
+    Expr clip(Scalar lower, Scalar upper) const {
+        if (lower.number > upper.number) {
+            throw invalid_argument("Invalid argument: Expr::clip() expects lower <= upper");
+        }
+        return arithmetic(ArithOp::min, arithmetic(ArithOp::max, *this, literal(lower)), literal(upper));
+    }
+
+    /**
+     * @brief Evaluates the predicate.
+     *
+     * @param column Called with a column name, returns that column (all of the same length)
+     * @return A mask with one bit per row, set where the predicate holds
+     * @throws invalid_argument If the expression is a bare column rather than a predicate
+     * @throws runtime_error If a column is compared with a constant of the other kind (see Column)
+     */
+    template <typename F>
+    Bitmap evaluate(F&& column) const {
+        return eval(*node, column);
+    }
+
+    /**
+     * @brief Computes an arithmetic expression for every row in one pass (see ColumnProgram).
+     *
+     * @param column Called with a column name, returns that column (all of the same length)
+     * @return The values, as an unnamed column (a bare column expression returns that column)
+     * @throws invalid_argument If the expression is a predicate or reads no column, or a
+     *         column it computes with is not "int" or "float"
+     */
+    template <typename F>
+    Column compute(F&& column) const {
+        return compute_node(*node, column);
+    }
+
+    /**
+     * @brief Returns the names of the columns the expression reads, each once.
+     */
+    vector<string> columns() const {
+        vector<string> names;
+        collect_columns(*node, names);
+        return names;
+    }
+
+    /**
+     * @brief Returns a copy reading renamed columns.
+     *
+     * @param names Maps old column names to new ones; names not in the map are kept
+     */
+    Expr renamed(const map<string, string>& names) const {
+        return Expr(rename_node(node, names));
+    }
+
+private:
+    struct Node {
+        enum Kind { column, compare, conjunction, disjunction, negation, literal, arithmetic, math };
+
+        Kind kind;
+        string name; // column, and compare of a column
+        CmpOp op = CmpOp::eq; // compare
+        bool is_string = false; // compare: key is text rather than number
+        double number = 0;
+        string text;
+        Scalar value = 0; // literal
+        ArithOp arith = ArithOp::add; // arithmetic
+        MathFn fn = MathFn::neg; // math
+        // conjunction, disjunction, arithmetic; negation, math and compare of an arithmetic
+        // expression use left only
+        shared_ptr<const Node> left, right;
+
+        bool is_numeric() const {
+            return kind == column || kind == literal || kind == arithmetic || kind == math;
+        }
+    };
+
+    shared_ptr<const Node> node;
+
+    explicit Expr(shared_ptr<const Node> node) : node(std::move(node)) {}
+
+    Expr compare(CmpOp op, double number, const string& text, bool is_string = false) const {
+        if (!node->is_numeric()) {
+            throw invalid_argument("Invalid argument: Expr comparisons expect a column on the left, e.g. Expr::col(\"Age\") > 30");
+        }
+        auto result = make_shared<Node>();
+        result->kind = Node::compare;
+        if (node->kind == Node::column) {
+            result->name = node->name;
+        } else {
+            result->left = node;
+        }
+        result->op = op;
+        result->is_string = is_string;
+        result->number = number;
+        result->text = text;
+        return Expr(std::move(result));
+    }
+
+    static Expr literal(Scalar x) {
+        auto result = make_shared<Node>();
+        result->kind = Node::literal;
+        result->value = x;
+        return Expr(std::move(result));
+    }
+
+    static Expr arithmetic(ArithOp op, const Expr& a, const Expr& b) {
+        if (!a.node->is_numeric() || !b.node->is_numeric()) {
+            throw invalid_argument("Invalid argument: Expr arithmetic expects columns and numbers, not predicates");
+        }
+        auto result = make_shared<Node>();
+        result->kind = Node::arithmetic;
+        result->arith = op;
+        result->left = a.node;
+        result->right = b.node;
+        return Expr(std::move(result));
+    }
+
+    Expr math(MathFn fn) const {
+        if (!node->is_numeric()) {
+            throw invalid_argument("Invalid argument: Expr arithmetic expects columns and numbers, not predicates");
+        }
+        auto result = make_shared<Node>();
+        result->kind = Node::math;
+        result->fn = fn;
+        result->left = node;
+        return Expr(std::move(result));
+    }
+
+    static Expr combine(typename Node::Kind kind, const Expr& a, const Expr& b) {
+        auto result = make_shared<Node>();
+        result->kind = kind;
+        result->left = a.node;
+        if (kind != Node::negation) {
+            result->right = b.node;
+        }
+        return Expr(std::move(result));
+    }
+
+    template <typename F>
+    static Bitmap eval(const Node& n, F& column) {
+        switch (n.kind) {
+        case Node::conjunction:
+            return eval(*n.left, column) & eval(*n.right, column);
+        case Node::disjunction:
+            return eval(*n.left, column) | eval(*n.right, column);
+        case Node::negation:
+            return ~eval(*n.left, column);
+        case Node::compare:
+            break;
+        default:
+            throw invalid_argument("Invalid argument: Expr::evaluate() expects a comparison, not a bare column or arithmetic");
+        }
+        Column computed;
+        if (n.left) {
+            computed = compute_node(*n.left, column);
+        }
+        const Column& col = n.left ? computed : column(n.name);
+        if (n.is_string) {
+            switch (n.op) {
+            case CmpOp::eq: return col == n.text;
+            case CmpOp::ne: return col != n.text;
+            case CmpOp::lt: return col < n.text;
+            case CmpOp::gt: return col > n.text;
+            case CmpOp::le: return col <= n.text;
+            default: return col >= n.text;
+            }
+        }
+        switch (n.op) {
+        case CmpOp::eq: return col == n.number;
+        case CmpOp::ne: return col != n.number;
+        case CmpOp::lt: return col < n.number;
+        case CmpOp::gt: return col > n.number;
+        case CmpOp::le: return col <= n.number;
+        default: return col >= n.number;
+        }
+    }
+
+    template <typename F>
+    static Column compute_node(const Node& n, F& column) {
+        if (n.kind == Node::column) {
+            return column(n.name);
+        }
+        ColumnProgram program;
+        size_t result = compile(n, column, program);
+        return program.run(result, "");
+    }
+
+    /**
+     * @brief Adds the steps computing n to program; returns the step holding its values.
+     */
+    template <typename F>
+    static size_t compile(const Node& n, F& column, ColumnProgram& program) {
+        switch (n.kind) {
+        case Node::column:
+            return program.load(column(n.name));
+        case Node::literal:
+            return program.constant(n.value);
+        case Node::arithmetic: {
+            size_t a = compile(*n.left, column, program);
+            size_t b = compile(*n.right, column, program);
+            return program.binary(n.arith, a, b);
+        }
+        case Node::math:
+            return program.unary(n.fn, compile(*n.left, column, program));
+        default:
+            throw invalid_argument("Invalid argument: Expr::compute() expects an arithmetic expression, not a predicate");
+        }
+    }
+
+    static void collect_columns(const Node& n, vector<string>& names) {
+        if (n.kind == Node::column || (n.kind == Node::compare && !n.left)) {
+            if (find(names.begin(), names.end(), n.name) == names.end()) {
+                names.push_back(n.name);
+            }
+            return;
+        }
+        if (n.left) {
+            collect_columns(*n.left, names);
+        }
+        if (n.right) {
+            collect_columns(*n.right, names);
+        }
+    }
+
+    static shared_ptr<const Node> rename_node(const shared_ptr<const Node>& n, const map<string, string>& names) {
+        auto result = make_shared<Node>(*n);
+        auto it = names.find(n->name);
+        if (it != names.end()) {
+            result->name = it->second;
+        }
+        if (n->left) {
+            result->left = rename_node(n->left, names);
+        }
+        if (n->right) {
+            result->right = rename_node(n->right, names);
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Read-only view of a whole file's contents.
+ *
+ * On POSIX systems the file is memory-mapped, so its bytes are paged in by the
+ * kernel on demand and never copied into the process heap. Other platforms fall
+ * back to reading the file into a buffer.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Opens and maps a file.
+     *
+     * @param path Path to the file
+     * @throws runtime_error If the file cannot be found or mapped
+     */
+    explicit MappedFile(const string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Error: File not found!");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            throw runtime_error("Error: File not found!");
+        }
+        len = static_cast<size_t>(st.st_size);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        // a larger read-ahead window for the page cache
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (len > 0) {
+            void* addr = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw runtime_error("Error: Unable to map file!");
+            }
+            ::madvise(addr, len, MADV_SEQUENTIAL);
+            ptr = static_cast<const char*>(addr);
+        }
+        ::close(fd);
+#else
+        ifstream file(path, ios::binary);
+        if (!file) {
+            throw runtime_error("Error: File not found!");
+        }
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        ptr = buffer.data();
+        len = buffer.size();
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (ptr != nullptr) {
+            ::munmap(const_cast<char*>(ptr), len);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return ptr;
+    }
+
+    size_t size() const {
+        return len;
+    }
+
+    /**
+     * @brief Starts reading a range of the mapping in the background.
+     *
+     * Returns at once; the kernel reads the pages ahead, so the thread that later scans
+     * them finds them in memory instead of waiting for each one.
+     *
+     * @param offset Offset of the first byte
+     * @param bytes Number of bytes; the range is cut at the end of the file
+     */
+    void will_need(size_t offset, size_t bytes) const {
+#if defined(__unix__) || defined(__APPLE__)
+        if (offset >= len) {
+            return;
+        }
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t start = offset / page * page;
+        bytes = std::min(bytes, len - offset) + (offset - start);
+        ::madvise(const_cast<char*>(ptr) + start, bytes, MADV_WILLNEED);
+#else
+        (void)offset;
+        (void)bytes;
+#endif
+    }
+
+    /**
+     * @brief Hints that the bytes before upto will not be read again.
+     *
+     * Their pages are dropped from memory; reading them again pages them back in from the file.
+     */
+    void release(const char* upto) const {
+#if defined(__unix__) || defined(__APPLE__)
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t bytes = static_cast<size_t>(upto - ptr) / page * page;
+        if (bytes > 0) {
+            ::madvise(const_cast<char*>(ptr), bytes, MADV_DONTNEED);
+        }
+#else
+        (void)upto;
+#endif
+    }
+
+private:
+    const char* ptr = nullptr;
+    size_t len = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+    vector<char> buffer;
+#endif
+};
+
+/**
+ * @brief Streams the decompressed bytes of a gzip or zstd file held in memory.
+ *
+ * Support for each format is compiled in on request: define LESSER_PANDAS_ZLIB (and link
+ * with -lz) for gzip, LESSER_PANDAS_ZSTD (and link with -lzstd) for zstd, before including
+ * the header. Files made of several concatenated gzip members or zstd frames are read
+ * to the end.
+ */
+class Decompressor {
+public:
+    enum Format { plain, gzip, zstd };
+
+    /**
+     * @brief Recognizes a compressed file by its magic bytes.
+     */
+    static Format detect(const char* data, size_t size) {
+        if (size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f && static_cast<unsigned char>(data[1]) == 0x8b) {
+            return gzip;
+        }
+        if (size >= 4 && memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0) {
+            return zstd;
+        }
+        return plain;
+    }
+
+    /**
+     * @param data The compressed bytes, which must outlive the decompressor
+     * @param size Number of compressed bytes
+     * @param format gzip or zstd
+     * @throws runtime_error If support for the format is not compiled in
+     */
+    Decompressor(const char* data, size_t size, Format format)
+    : input(data), input_size(size), format(format) {
+        if (format == gzip) {
+#if defined(LESSER_PANDAS_ZLIB)
+            // 15 + 32: the largest window, and a gzip or zlib header detected automatically
+            if (inflateInit2(&inflater, 15 + 32) != Z_OK) {
+                throw runtime_error("Error: Unable to start gzip decompression!");
+            }
+#else
+            throw runtime_error("Error: Reading a gzip file needs LESSER_PANDAS_ZLIB defined (and -lz)");
+#endif
+        } else if (format == zstd) {
+#if defined(LESSER_PANDAS_ZSTD)
+            stream = ZSTD_createDStream();
+            if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream))) {
+                ZSTD_freeDStream(stream);
+                throw runtime_error("Error: Unable to start zstd decompression!");
+            }
+#else
+            throw runtime_error("Error: Reading a zstd file needs LESSER_PANDAS_ZSTD defined (and -lzstd)");
+#endif
+        } else {
+            throw invalid_argument("Invalid argument: Decompressor expects a gzip or zstd format");
+        }
+    }
+
+    ~Decompressor() {
+#if defined(LESSER_PANDAS_ZLIB)
+        if (format == gzip) {
+            inflateEnd(&inflater);
+        }
+#endif
+#if defined(LESSER_PANDAS_ZSTD)
+        if (format == zstd) {
+            ZSTD_freeDStream(stream);
+        }
+#endif
+    }
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    /**
+     * @brief Decompresses the next bytes into out.
+     *
+     * @param out Buffer receiving the bytes
+     * @param capacity Size of out
+     * @return Number of bytes written, 0 once the whole file has been decompressed
+     * @throws runtime_error If the data is corrupt or truncated
+     */
+    size_t read(char* out, size_t capacity) {
+#if defined(LESSER_PANDAS_ZLIB)
+        if (format == gzip) {
+            return read_gzip(out, capacity);
+        }
+#endif
+#if defined(LESSER_PANDAS_ZSTD)
+        if (format == zstd) {
+            return read_zstd(out, capacity);
+        }
+#endif
+        (void)out;
+        (void)capacity;
+        return 0;
+    }
+
+    /**
+     * @brief Returns how many compressed bytes have been consumed so far.
+     */
+    size_t consumed() const {
+#if defined(LESSER_PANDAS_ZLIB)
+        if (format == gzip) {
+            return used - inflater.avail_in;
+        }
+#endif
+        return used;
+    }
+
+private:
+    const char* input;
+    size_t input_size;
+    size_t used = 0; // compressed bytes handed to the decoder
+    Format format;
+    bool finished = false;
+#if defined(LESSER_PANDAS_ZLIB)
+    z_stream inflater{};
+
+    size_t read_gzip(char* out, size_t capacity) {
+        constexpr size_t max_step = 1 << 30; // zlib counts bytes in 32-bit integers
+        inflater.next_out = reinterpret_cast<Bytef*>(out);
+        inflater.avail_out = static_cast<uInt>(std::min(capacity, max_step));
+        while (inflater.avail_out > 0 && !finished) {
+            if (inflater.avail_in == 0) {
+                if (used == input_size) {
+                    throw runtime_error("Error: Truncated gzip file!");
+                }
+                size_t step = std::min(input_size - used, max_step);
+                inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input + used));
+                inflater.avail_in = static_cast<uInt>(step);
+                used += step;
+            }
+            int ret = inflate(&inflater, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                // another member may follow
+                if (inflater.avail_in == 0 && used == input_size) {
+                    finished = true;
+                } else if (inflateReset(&inflater) != Z_OK) {
+                    throw runtime_error("Error: Invalid gzip file!");
+                }
+            } else if (ret != Z_OK) {
+                throw runtime_error("Error: Invalid gzip file!");
+            }
+        }
+        return std::min(capacity, max_step) - inflater.avail_out;
+    }
+#endif
+#if defined(LESSER_PANDAS_ZSTD)
+    ZSTD_DStream* stream = nullptr;
+    size_t pending = 0; // last hint of ZSTD_decompressStream(): 0 when a frame is complete
+
+    size_t read_zstd(char* out, size_t capacity) {
+        ZSTD_outBuffer output = {out, capacity, 0};
+        while (output.pos < output.size && !finished) {
+            ZSTD_inBuffer in = {input, input_size, used};
+            size_t before = output.pos;
+            size_t ret = ZSTD_decompressStream(stream, &output, &in);
+            if (ZSTD_isError(ret)) {
+                throw runtime_error("Error: Invalid zstd file!");
+            }
+            bool progress = in.pos != used || output.pos != before;
+            used = in.pos;
+            pending = ret;
+            if (used == input_size && output.pos < output.size) {
+                // all input consumed and the output not full: the decoder has flushed everything
+                if (pending != 0) {
+                    throw runtime_error("Error: Truncated zstd file!");
+                }
+                finished = true;
+            } else if (!progress) {
+                throw runtime_error("Error: Invalid zstd file!");
+            }
+        }
+        return output.pos;
+    }
+#endif
+};
+
+/**
+ * @brief Runs a Decompressor on a background thread and hands its output over in blocks.
+ *
+ * The blocks pass through a bounded queue: the thread decompresses at most max_blocks
+ * blocks ahead of the reader and then waits, so decompression overlaps with parsing
+ * while the memory in flight stays bounded. The compressed input is read ahead as it
+ * is consumed, and its pages are handed back to the kernel once decoded.
+ */
+class DecompressedBlocks {
+public:
+    static constexpr size_t block_bytes = size_t(4) << 20;
+    static constexpr size_t default_max_blocks = 8;
+
+    /**
+     * @param max_blocks Blocks decompressed ahead of the reader at most
+     * @throws runtime_error If support for the file's format is not compiled in
+     */
+    DecompressedBlocks(const MappedFile& file, Decompressor::Format format, size_t max_blocks = default_max_blocks)
+    : decoder(file.data(), file.size(), format), capacity(std::max<size_t>(1, max_blocks)) {
+        worker = thread([this, &file] {
+            try {
+                for (;;) {
+                    // hand back the compressed pages already decoded and read the next ones ahead
+                    file.release(file.data() + decoder.consumed());
+                    file.will_need(decoder.consumed(), 2 * block_bytes);
+                    string block(block_bytes, '\0');
+                    size_t n = decoder.read(&block[0], block.size());
+                    if (n == 0) {
+                        break;
+                    }
+                    block.resize(n);
+                    unique_lock<mutex> guard(lock);
+                    changed.wait(guard, [&] {
+                        return closed || queue.size() < capacity;
+                    });
+                    if (closed) {
+                        return;
+                    }
+                    queue.push_back(std::move(block));
+                    changed.notify_all();
+                }
+            } catch (...) {
+                lock_guard<mutex> guard(lock);
+                error = current_exception();
+            }
+            lock_guard<mutex> guard(lock);
+            done = true;
+            changed.notify_all();
+        });
+    }
+
+    ~DecompressedBlocks() {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    DecompressedBlocks(const DecompressedBlocks&) = delete;
+    DecompressedBlocks& operator=(const DecompressedBlocks&) = delete;
+
+    /**
+     * @brief Waits for the next block.
+     *
+     * @param block Receives the bytes
+     * @return False once every block has been returned
+     * @throws runtime_error If the file is corrupt or truncated
+     */
+    bool next(string& block) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] {
+            return !queue.empty() || done;
+        });
+        if (queue.empty()) {
+            if (error) {
+                rethrow_exception(error);
+            }
+            return false;
+        }
+        block = std::move(queue.front());
+        queue.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+private:
+    Decompressor decoder;
+    size_t capacity; // blocks queued at most
+    mutex lock;
+    condition_variable changed; // a block was queued or taken, or the stream ended
+    deque<string> queue;
+    bool done = false;
+    bool closed = false;
+    exception_ptr error;
+    thread worker;
+};
+
+/**
+ * @brief Splits CSV text into records and fields in a single pass, without copying.
+ *
+ * Fields are returned as views into the scanned text. Quoted fields may contain
+ * delimiters, newlines and doubled quotes; the few fields that need unescaping are
+ * copied into storage owned by the scanner, so every view stays valid for the
+ * scanner's lifetime. Both "\n" and "\r\n" line endings are accepted.
+ */
+class CsvScanner {
+public:
+    CsvScanner(const char* begin, const char* end, char delim = ',')
+    : pos(begin), end(end), delim(delim) {}
+
+    /**
+     * @brief Returns a pointer to the first byte not consumed yet.
+     */
+    const char* position() const {
+        return pos;
+    }
+
+    /**
+     * @brief Reads the next non-empty record.
+     *
+     * @param fields Cleared and filled with views of the record's fields, valid until the next call
+     * @return False once the end of the text is reached
+     */
+    bool next_row(vector<string_view>& fields) {
+        fields.clear();
+        num_unescaped = 0;
+        // skip blank lines
+        while (pos < end && (*pos == '\n' || *pos == '\r')) {
+            pos++;
+        }
+        if (pos >= end) {
+            return false;
+        }
+
+        while (true) {
+            fields.push_back(next_field());
+            if (pos >= end) {
+                break;
+            }
+            if (*pos == delim) {
+                pos++;
+                continue;
+            }
+            // end of record
+            if (*pos == '\r') {
+                pos++;
+            }
+            if (pos < end && *pos == '\n') {
+                pos++;
+            }
+            break;
+        }
+        return true;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+    char delim;
+    deque<string> unescaped; // storage for quoted fields containing doubled quotes, reused across records
+    size_t num_unescaped = 0; // entries of unescaped used by the current record
+
+    string_view next_field() {
+        const char* start = pos;
+        if (pos < end && *pos == '"') {
+            start = ++pos;
+            bool escaped = false;
+            while (pos < end) {
+                if (*pos == '"') {
+                    if (pos + 1 < end && pos[1] == '"') {
+                        escaped = true;
+                        pos += 2;
+                        continue;
+                    }
+                    break;
+                }
+                pos++;
+            }
+            string_view field(start, pos - start);
+            if (pos < end) {
+                pos++; // closing quote
+            }
+            // ignore anything between the closing quote and the next delimiter
+            while (pos < end && *pos != delim && *pos != '\n' && *pos != '\r') {
+                pos++;
+            }
+            if (!escaped) {
+                return field;
+            }
+            if (num_unescaped == unescaped.size()) {
+                unescaped.emplace_back();
+            }
+            string& owned = unescaped[num_unescaped++];
+            owned.clear();
+            for (size_t i = 0; i < field.size(); i++) {
+                owned.push_back(field[i]);
+                if (field[i] == '"') {
+                    i++;
+                }
+            }
+            return owned;
+        }
+
+        while (pos < end && *pos != delim && *pos != '\n' && *pos != '\r') {
+            pos++;
+        }
+        return string_view(start, pos - start);
+    }
+};
+
+/**
+ * @brief Options controlling how a CSV file is loaded into a DataFrame.
+ */
+struct CsvOptions {
+    char delim = ','; // field delimiter
+    size_t num_threads = 1; // threads used to parse the file (0 = all of the thread pool)
+    size_t infer_rows = 0; // infer dtypes from the first N data rows only (0 = all rows)
+    bool encode_strings = true; // dictionary-encode string columns with few distinct values (see Column::encode())
+    vector<string> usecols; // load only these columns, in file order (empty = all); the others are never parsed
+    map<string, string> dtypes; // column name -> "int", "float" or "string"; these columns skip inference
+};
+
+/**
+ * @brief Loads a CSV file into typed columns, optionally on several threads.
+ *
+ * The mapped file is split into byte-range chunks that end on record boundaries.
+ * Each worker scans its chunk into per-chunk column fragments, parsing numeric
+ * fields as it goes; the fragments then agree on a dtype per column and are
+ * stitched together in file order.
+ *
+ * Dtype inference happens during the scan: every column starts as "int" and is
+ * widened to "float" or "string" by the first field that does not parse, so string
+ * columns stop paying for numeric parsing after their first value. With
+ * CsvOptions::infer_rows the starting dtypes come from a sample of the first rows
+ * instead, and columns listed in CsvOptions::dtypes are never widened.
+ *
+ * String columns with at most one distinct value per dict_ratio rows are
+ * dictionary-encoded (see Column::encode()) unless CsvOptions::encode_strings is off.
+ *
+ * Gzip and zstd files are recognized by their first bytes (see Decompressor). read()
+ * decompresses them on a background thread and scans the text in batches of
+ * stream_batch_bytes as it arrives, so decompression overlaps with parsing and only
+ * the parsed columns plus a few batches of text are in memory at a time.
+ *
+ * @note Chunk boundaries are found from the quote parity at each split point, so
+ *       quoted fields containing newlines are never cut in half. This assumes quotes
+ *       only appear around fields (or doubled inside them), as RFC 4180 requires.
+ */
+class CsvReader {
+public:
+    static constexpr size_t min_chunk_bytes = 1 << 20; // smallest range worth its own thread
+    static constexpr size_t dict_ratio = 8; // encode string columns with at most one distinct value per dict_ratio rows
+    static constexpr size_t min_dict_size = 1 << 10; // distinct values a fragment may always collect while scanning
+    static constexpr size_t stream_batch_bytes = size_t(32) << 20; // decompressed text scanned at a time
+    static constexpr size_t read_ahead_bytes = size_t(16) << 20; // bytes of each range read ahead before scanning it
+    static constexpr size_t read_next_blocks = 2; // blocks read_next() decompresses ahead of the reader
+
+    CsvReader(const string& path, const CsvOptions& options)
+    : file(path), options(options), format(Decompressor::detect(file.data(), file.size())) {}
+
+    /**
+     * @brief Returns the names of the columns read() loads, without reading any data row.
+     *
+     * Compressed files are only decompressed up to the end of the header row.
+     */
+    vector<string> header() const {
+        string text;
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        if (format != Decompressor::plain) {
+            DecompressedBlocks blocks(file, format);
+            string block;
+            while (record_end(text, 0) == string::npos && blocks.next(block)) {
+                text += block;
+            }
+            begin = text.data();
+            end = begin + text.size();
+        }
+        CsvScanner scanner(begin, end, options.delim);
+        vector<string_view> fields;
+        vector<string> names;
+        scanner.next_row(fields);
+        for (string_view field : fields) {
+            if (options.usecols.empty() || find(options.usecols.begin(), options.usecols.end(), field) != options.usecols.end()) {
+                names.emplace_back(field);
+            }
+        }
+        return names;
+    }
+
+    /**
+     * @brief Reads the whole file.
+     *
+     * @param columns Receives the column names from the header row
+     * @param cols Receives one typed column per header field (or per CsvOptions::usecols entry)
+     * @param filter If set, only the rows matching it are kept; each chunk is filtered as
+     *               soon as it is parsed, so rejected rows are never stitched together
+     * @throws runtime_error If a row has more fields than the header
+     * @throws runtime_error If a value does not match the dtype given for its column in CsvOptions::dtypes
+     * @throws invalid_argument If CsvOptions::dtypes names an unknown dtype
+     * @throws std::out_of_range If a column in CsvOptions::usecols or in the filter is not loaded
+     * @throws runtime_error If a compressed file is corrupt or its format is not compiled in
+     */
+    void read(vector<string>& columns, vector<Column>& cols, const Expr* filter = nullptr) {
+        if (format != Decompressor::plain) {
+            read_stream(columns, cols, filter);
+            return;
+        }
+        const char* end = file.data() + file.size();
+        const char* body = read_header(file.data(), end, columns);
+        if (body) {
+            read_rows(body, end, columns, cols, filter);
+        }
+    }
+
+    /**
+     * @brief Reads the next rows of the file, continuing where the previous call stopped.
+     *
+     * Each call parses about max_rows records into new columns, so memory use depends on
+     * max_rows rather than on the size of the file; the pages of the mapped file already
+     * read are handed back to the kernel, and the next max_rows records are read ahead while
+     * the caller works on these. A column never narrows from one call to the next, but a
+     * later call may widen it (e.g. int to float) when its rows need that.
+     *
+     * @note A compressed file is decompressed on a background thread as the calls need
+     *       it; only the text of the records not read yet is kept between calls.
+     *
+     * @param max_rows Maximum number of records to read
+     * @param columns Receives the column names from the header row
+     * @param cols Receives the typed columns of the rows read
+     * @return False, leaving columns and cols untouched, once every row has been read
+     * @throws See read()
+     */
+    bool read_next(size_t max_rows, vector<string>& columns, vector<Column>& cols) {
+        LP_PROFILE_SCOPE("read_csv_chunk");
+        if (format != Decompressor::plain) {
+            return read_next_stream(max_rows, columns, cols);
+        }
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        if (!next_row) {
+            next_row = read_header(begin, end, names);
+            if (!next_row) {
+                next_row = end;
+            }
+        }
+        // skip blank lines so the last call does not return an empty chunk
+        while (next_row < end && (*next_row == '\n' || *next_row == '\r')) {
+            next_row++;
+        }
+        if (next_row >= end) {
+            return false;
+        }
+
+        RecordCount count;
+        const char* stop = count_records(next_row, end, max_rows, count);
+        columns = names;
+        read_rows(next_row, stop, columns, cols, nullptr);
+        raise_floor(cols);
+        size_t bytes = stop - next_row;
+        next_row = stop;
+        file.release(next_row);
+        // start reading the next call's records while the caller works on these
+        file.will_need(next_row - begin, bytes);
+        return true;
+    }
+
+private:
+    // ordered from narrowest to widest
+    enum Kind : uint8_t { INT, FLOAT, STRING };
+
+    struct Chunk {
+        const char* begin = nullptr; // the chunk's range of the text, null once it is freed
+        const char* end = nullptr;
+        size_t num_rows = 0;
+        vector<Kind> kinds; // dtype each fragment has been widened to
+        vector<Column> parsed; // typed fragments
+        size_t error_row = 0; // 1-based row (within the chunk) that failed, 0 if none
+        string error;
+    };
+
+    // a batch of the decompressed text read by read_stream(), and the chunks parsed from it
+    struct Batch {
+        size_t offset = 0; // of the batch in the decompressed text
+        size_t bytes = 0;
+        size_t first_row = 0; // records before the batch, for error messages
+        vector<Chunk> chunks;
+    };
+
+    // state of count_records(), carried over when the text arrives in pieces
+    struct RecordCount {
+        size_t rows = 0;
+        bool quoted = false;
+        bool blank = true; // no field characters since the last line break
+    };
+
+    MappedFile file;
+    CsvOptions options;
+    Decompressor::Format format;
+    unique_ptr<DecompressedBlocks> blocks; // read_next() on a compressed file: the text to come
+    string window; // read_next() on a compressed file: decompressed text not read yet
+    bool blocks_done = false; // every block has been appended to window
+    vector<bool> fixed; // dtype given by the user, never widened
+    size_t num_fields = 0; // fields in the header row
+    vector<size_t> source; // field index of each loaded column
+    vector<string> names; // loaded column names, for read_next()
+    const char* next_row = nullptr; // first record read_next() has not read yet
+    vector<Kind> floor; // narrowest dtype read_next() may give each column
+    size_t rows_done = 0; // records read by earlier read_next() calls, for error messages
+
+    /**
+     * @brief Reads the header row into columns and resolves CsvOptions::usecols.
+     *
+     * @param begin Start of the text
+     * @param end End of the text
+     * @return The start of the first record, or null if the text has no header row
+     */
+    const char* read_header(const char* begin, const char* end, vector<string>& columns) {
+        CsvScanner header_scanner(begin, end, options.delim);
+        vector<string_view> fields;
+        if (!header_scanner.next_row(fields)) {
+            return nullptr;
+        }
+        num_fields = fields.size();
+        source.clear();
+        for (size_t idx = 0; idx < fields.size(); idx++) {
+            if (options.usecols.empty()
+                || find(options.usecols.begin(), options.usecols.end(), fields[idx]) != options.usecols.end()) {
+                source.push_back(idx);
+                columns.emplace_back(fields[idx]);
+            }
+        }
+        for (const string& col_name : options.usecols) {
+            if (find(columns.begin(), columns.end(), col_name) == columns.end()) {
+                throw std::out_of_range("Column not found: " + col_name);
+            }
+        }
+        fixed.assign(columns.size(), false);
+        for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+            fixed[jdx] = options.dtypes.count(columns[jdx]) > 0;
+        }
+        return header_scanner.position();
+    }
+
+    /**
+     * @brief Parses the records in [begin, end) into cols, on several threads when it is large enough.
+     */
+    void read_rows(const char* begin, const char* end, const vector<string>& columns, vector<Column>& cols, const Expr* filter) {
+        vector<Kind> kinds = start_kinds(columns, begin, end);
+        vector<Chunk> chunks;
+        scan_rows(begin, end, columns, kinds, chunks);
+        finish_rows(columns, kinds, chunks, cols, filter);
+    }
+
+    /**
+     * @brief Reads a compressed file, scanning each batch of text while the next one is decompressed.
+     *
+     * Each batch is converted to typed fragments (and filtered) with the widest dtypes seen
+     * so far as soon as it is scanned, and its text is freed. Should a later batch find
+     * strings in a column, the batches that parsed it as numbers are decompressed again
+     * and parsed as text (see reparse()).
+     */
+    void read_stream(vector<string>& columns, vector<Column>& cols, const Expr* filter) {
+        vector<Batch> batches;
+        vector<Kind> kinds;
+        {
+            DecompressedBlocks blocks(file, format);
+            string pending; // decompressed text not scanned yet
+            size_t offset = 0; // decompressed bytes before pending
+            string block;
+            bool header_read = false;
+            bool more = true;
+            while (more) {
+                more = blocks.next(block);
+                if (!more) {
+                    block.clear();
+                }
+                if (pending.empty()) {
+                    pending.swap(block);
+                } else {
+                    pending += block;
+                }
+                if (!header_read) {
+                    size_t stop = record_end(pending, 0);
+                    if (stop == string::npos && more) {
+                        continue;
+                    }
+                    const char* body = read_header(pending.data(), pending.data() + pending.size(), columns);
+                    if (!body) {
+                        return;
+                    }
+                    offset += body - pending.data();
+                    pending.erase(0, body - pending.data());
+                    header_read = true;
+                }
+                // cut each batch after its last complete record
+                size_t cut = pending.size();
+                if (more) {
+                    if (pending.size() < stream_batch_bytes) {
+                        continue;
+                    }
+                    cut = last_record_end(pending);
+                    if (cut == 0) {
+                        continue;
+                    }
+                }
+                string text = pending.substr(0, cut);
+                pending.erase(0, cut);
+                Batch batch;
+                batch.offset = offset;
+                batch.bytes = cut;
+                batch.first_row = rows_done;
+                offset += cut;
+                if (batches.empty()) {
+                    kinds = start_kinds(columns, text.data(), text.data() + text.size());
+                }
+                scan_rows(text.data(), text.data() + text.size(), columns, kinds, batch.chunks);
+                convert_batch(batch, columns, kinds, filter);
+                batches.push_back(std::move(batch));
+            }
+        }
+
+        vector<size_t> redo;
+        for (size_t k = 0; k < batches.size(); k++) {
+            for (const Chunk& chunk : batches[k].chunks) {
+                bool stale = false;
+                for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+                    stale = stale || (kinds[jdx] == STRING && chunk.kinds[jdx] != STRING);
+                }
+                if (stale) {
+                    redo.push_back(k);
+                    break;
+                }
+            }
+        }
+        if (!redo.empty()) {
+            reparse(batches, redo, columns, kinds, filter);
+        }
+
+        vector<Chunk> chunks;
+        for (Batch& batch : batches) {
+            for (Chunk& chunk : batch.chunks) {
+                chunks.push_back(std::move(chunk));
+            }
+        }
+        // already filtered; numeric fragments only widen from int to float here
+        finish_rows(columns, kinds, chunks, cols, nullptr);
+    }
+
+    /**
+     * @brief Converts the scanned chunks of a batch to the widest dtypes seen so far and
+     *        filters them, after which the batch's text is no longer needed.
+     *
+     * @param kinds Widened to the dtypes the batch needed
+     */
+    void convert_batch(Batch& batch, const vector<string>& columns, vector<Kind>& kinds, const Expr* filter) {
+        LP_PROFILE_SCOPE("csv.convert");
+        for (const Chunk& chunk : batch.chunks) {
+            for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+                kinds[jdx] = std::max(kinds[jdx], chunk.kinds[jdx]);
+            }
+        }
+        parallel_for(batch.chunks.size(), thread_count(), [&](size_t k) {
+            Chunk& chunk = batch.chunks[k];
+            finish(chunk, kinds);
+            chunk.kinds = kinds;
+            if (filter) {
+                keep_matching(chunk, columns, *filter);
+            }
+            chunk.begin = nullptr;
+            chunk.end = nullptr;
+        });
+    }
+
+    /**
+     * @brief Decompresses the file again and parses the given batches with the final dtypes.
+     *
+     * @param redo Indices of the batches to parse again, in increasing order
+     * @throws runtime_error If the file no longer holds the same text
+     */
+    void reparse(vector<Batch>& batches, const vector<size_t>& redo, const vector<string>& columns, vector<Kind>& kinds, const Expr* filter) {
+        DecompressedBlocks blocks(file, format);
+        string text; // decompressed text, starting at offset
+        size_t offset = 0;
+        string block;
+        size_t saved_rows = rows_done;
+        for (size_t k : redo) {
+            Batch& batch = batches[k];
+            for (;;) {
+                // drop the text before the batch as it arrives
+                size_t drop = std::min(text.size(), batch.offset - offset);
+                text.erase(0, drop);
+                offset += drop;
+                if (offset == batch.offset && text.size() >= batch.bytes) {
+                    break;
+                }
+                if (!blocks.next(block)) {
+                    throw runtime_error("Error: The compressed file changed while it was read!");
+                }
+                text += block;
+            }
+            batch.chunks.clear();
+            rows_done = batch.first_row;
+            scan_rows(text.data(), text.data() + batch.bytes, columns, kinds, batch.chunks);
+            convert_batch(batch, columns, kinds, filter);
+        }
+        rows_done = saved_rows;
+    }
+
+    /**
+     * @brief read_next() on a compressed file: decompresses just past the next max_rows
+     *        records, keeping only the text that follows them.
+     */
+    bool read_next_stream(size_t max_rows, vector<string>& columns, vector<Column>& cols) {
+        if (!blocks) {
+            // a chunk is parsed at a time, so a shallow queue keeps memory close to a plain file's
+            blocks = make_unique<DecompressedBlocks>(file, format, read_next_blocks);
+            while (record_end(window, 0) == string::npos && pull_block()) {
+            }
+            const char* body = read_header(window.data(), window.data() + window.size(), names);
+            window.erase(0, body ? body - window.data() : window.size());
+        }
+        // skip blank lines so the last call does not return an empty chunk
+        for (;;) {
+            window.erase(0, window.find_first_not_of("\r\n"));
+            if (!window.empty() || !pull_block()) {
+                break;
+            }
+        }
+        if (window.empty()) {
+            return false;
+        }
+
+        RecordCount count;
+        size_t stop = 0;
+        for (;;) {
+            stop = count_records(window.data() + stop, window.data() + window.size(), max_rows, count) - window.data();
+            if (count.rows == max_rows || !pull_block()) {
+                break;
+            }
+        }
+        columns = names;
+        read_rows(window.data(), window.data() + stop, columns, cols, nullptr);
+        raise_floor(cols);
+        window.erase(0, stop);
+        return true;
+    }
+
+    /**
+     * @brief Appends the next decompressed block to window; false once there are none left.
+     */
+    bool pull_block() {
+        string block;
+        if (blocks_done || !blocks->next(block)) {
+            blocks_done = true;
+            return false;
+        }
+        window += block;
+        return true;
+    }
+
+    /**
+     * @brief Advances over [begin, end) until count.rows reaches max_rows, counting records by
+     *        their line breaks outside quoted fields; like CsvScanner, lines holding nothing but
+     *        line break characters are not records.
+     *
+     * @return Where the count stopped: just after the last record's line break, or end
+     */
+    static const char* count_records(const char* begin, const char* end, size_t max_rows, RecordCount& count) {
+        const char* pos = begin;
+        for (; pos < end && count.rows < max_rows; pos++) {
+            if (*pos == '"') {
+                count.quoted = !count.quoted;
+                count.blank = false;
+            } else if (*pos == '\n' && !count.quoted) {
+                count.rows += count.blank ? 0 : 1;
+                count.blank = true;
+            } else if (*pos != '\r') {
+                count.blank = false;
+            }
+        }
+        return pos;
+    }
+
+    /**
+     * @brief Keeps the next read_next() call from narrowing the dtypes of cols.
+     */
+    void raise_floor(const vector<Column>& cols) {
+        floor.resize(cols.size(), INT);
+        for (size_t jdx = 0; jdx < cols.size(); jdx++) {
+            Kind kind = cols[jdx].dtype == "int" ? INT : cols[jdx].dtype == "float" ? FLOAT : STRING;
+            floor[jdx] = std::max(floor[jdx], kind);
+        }
+    }
+
+    /**
+     * @brief Returns the offset just after the first line break at or after from outside
+     *        quoted fields, or string::npos if text has none.
+     *
+     * @param from Offset of a record boundary
+     */
+    static size_t record_end(const string& text, size_t from) {
+        bool quoted = false;
+        for (size_t idx = from; idx < text.size(); idx++) {
+            if (text[idx] == '"') {
+                quoted = !quoted;
+            } else if (text[idx] == '\n' && !quoted) {
+                return idx + 1;
+            }
+        }
+        return string::npos;
+    }
+
+    /**
+     * @brief Returns the offset just after the last complete record of text (which starts
+     *        at a record boundary), or 0 if it has none.
+     */
+    static size_t last_record_end(const string& text) {
+        size_t last = text.rfind('\n');
+        if (last == string::npos) {
+            return 0;
+        }
+        // a line break ends a record when the quotes before it are balanced
+        if (std::count(text.begin(), text.begin() + last, '"') % 2 == 0) {
+            return last + 1;
+        }
+        size_t cut = 0;
+        for (size_t stop = record_end(text, 0); stop != string::npos && stop <= last + 1; stop = record_end(text, stop)) {
+            cut = stop;
+        }
+        return cut;
+    }
+
+    /**
+     * @brief Returns the dtypes the columns start the scan from: the inferred ones, no
+     *        narrower than the dtypes earlier read_next() calls settled on.
+     */
+    vector<Kind> start_kinds(const vector<string>& columns, const char* begin, const char* end) const {
+        vector<Kind> kinds = initial_kinds(columns, begin, end);
+        for (size_t jdx = 0; jdx < floor.size(); jdx++) {
+            if (!fixed[jdx]) {
+                kinds[jdx] = std::max(kinds[jdx], floor[jdx]);
+            }
+        }
+        return kinds;
+    }
+
+    size_t thread_count() const {
+        return options.num_threads == 0 ? ThreadPool::concurrency() : options.num_threads;
+    }
+
+    /**
+     * @brief Scans the records in [begin, end) into new chunks appended to chunks.
+     *
+     * @throws runtime_error If a record fails to parse
+     */
+    void scan_rows(const char* begin, const char* end, const vector<string>& columns, const vector<Kind>& kinds, vector<Chunk>& chunks) {
+        LP_PROFILE_ROWS(0, end - begin);
+        size_t num_threads = thread_count();
+        vector<const char*> bounds = split(begin, end, num_threads);
+        if (format == Decompressor::plain) {
+            // have the kernel read every range ahead at once, not each one as its scan reaches it
+            for (size_t k = 0; k + 1 < bounds.size(); k++) {
+                file.will_need(bounds[k] - file.data(), std::min<size_t>(bounds[k + 1] - bounds[k], read_ahead_bytes));
+            }
+        }
+
+        size_t first = chunks.size();
+        chunks.resize(first + bounds.size() - 1);
+        {
+            LP_PROFILE_SCOPE("csv.parse");
+            LP_PROFILE_ROWS(0, end - begin);
+            parallel_for(bounds.size() - 1, num_threads, [&](size_t k) {
+                scan(chunks[first + k], bounds[k], bounds[k + 1], columns, kinds);
+            });
+        }
+
+        size_t row_offset = rows_done;
+        for (size_t k = first; k < chunks.size(); k++) {
+            if (chunks[k].error_row != 0) {
+                throw runtime_error(chunks[k].error + " (row " + to_string(row_offset + chunks[k].error_row) + ")");
+            }
+            row_offset += chunks[k].num_rows;
+        }
+        LP_PROFILE_ROWS(row_offset - rows_done, 0);
+        rows_done = row_offset;
+    }
+
+    /**
+     * @brief Converts the scanned chunks to one dtype per column and stitches them into cols.
+     */
+    void finish_rows(const vector<string>& columns, vector<Kind>& kinds, vector<Chunk>& chunks, vector<Column>& cols, const Expr* filter) {
+        size_t num_threads = thread_count();
+        // a column ends up with the widest dtype any chunk needed
+        for (const Chunk& chunk : chunks) {
+            for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+                kinds[jdx] = std::max(kinds[jdx], chunk.kinds[jdx]);
+            }
+        }
+
+        {
+            LP_PROFILE_SCOPE("csv.convert");
+            parallel_for(chunks.size(), num_threads, [&](size_t k) {
+                finish(chunks[k], kinds);
+                if (filter) {
+                    keep_matching(chunks[k], columns, *filter);
+                }
+            });
+        }
+
+        // stitch the fragments together in file order
+        LP_PROFILE_SCOPE("csv.concat");
+        cols.resize(columns.size());
+        parallel_for(columns.size(), num_threads, [&](size_t jdx) {
+            cols[jdx] = std::move(chunks[0].parsed[jdx]);
+            for (size_t k = 1; k < chunks.size(); k++) {
+                cols[jdx].concat(std::move(chunks[k].parsed[jdx]));
+            }
+        });
+    }
+
+    static const char* kind_name(Kind kind) {
+        return kind == INT ? "int" : kind == FLOAT ? "float" : "string";
+    }
+
+    /**
+     * @brief Picks the dtype each column starts from, using the schema and the optional sample.
+     */
+    vector<Kind> initial_kinds(const vector<string>& columns, const char* begin, const char* end) const {
+        LP_PROFILE_SCOPE("csv.infer_dtypes");
+        vector<Kind> kinds(columns.size(), INT);
+        if (options.infer_rows > 0) {
+            CsvScanner scanner(begin, end, options.delim);
+            vector<string_view> fields;
+            for (size_t row = 0; row < options.infer_rows && scanner.next_row(fields); row++) {
+                for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+                    if (source[jdx] < fields.size()) {
+                        kinds[jdx] = std::max(kinds[jdx], classify(fields[source[jdx]]));
+                    }
+                }
+            }
+        }
+
+        for (size_t jdx = 0; jdx < columns.size(); jdx++) {
+            auto it = options.dtypes.find(columns[jdx]);
+            if (it == options.dtypes.end()) {
+                continue;
+            }
+            if (it->second == "int") {
+                kinds[jdx] = INT;
+            } else if (it->second == "float") {
+                kinds[jdx] = FLOAT;
+            } else if (it->second == "string") {
+                kinds[jdx] = STRING;
+            } else {
+                throw invalid_argument("Invalid type: CsvOptions::dtypes expects `dtype` to be int, float or string");
+            }
+        }
+        return kinds;
+    }
+
+    static Kind classify(string_view element) {
+        if (element.length() == 0 || is_integer(element)) {
+            return INT;
+        }
+        return is_float(element) ? FLOAT : STRING;
+    }
+
+    /**
+     * @brief Splits [begin, end) into up to n ranges that each start at a record boundary.
+     */
+    vector<const char*> split(const char* begin, const char* end, size_t n) const {
+        size_t bytes = end - begin;
+        n = std::max<size_t>(1, std::min(n, bytes / min_chunk_bytes));
+
+        vector<const char*> starts(n);
+        for (size_t k = 0; k < n; k++) {
+            starts[k] = begin + bytes / n * k;
+        }
+
+        // quote parity of each range tells whether the next range starts inside a quoted field
+        vector<size_t> quotes(n);
+        parallel_for(n, n, [&](size_t k) {
+            const char* stop = k + 1 < n ? starts[k + 1] : end;
+            quotes[k] = std::count(starts[k], stop, '"');
+        });
+
+        vector<const char*> bounds(n + 1);
+        bounds[0] = begin;
+        bounds[n] = end;
+        vector<bool> in_quotes(n, false);
+        for (size_t k = 1; k < n; k++) {
+            in_quotes[k] = in_quotes[k - 1] != (quotes[k - 1] % 2 == 1);
+        }
+        parallel_for(n - 1, n, [&](size_t i) {
+            size_t k = i + 1;
+            bool quoted = in_quotes[k];
+            const char* p = starts[k];
+            while (p < end && (quoted || *p != '\n')) {
+                if (*p == '"') {
+                    quoted = !quoted;
+                }
+                p++;
+            }
+            bounds[k] = p < end ? p + 1 : end;
+        });
+        for (size_t k = 1; k <= n; k++) {
+            bounds[k] = std::max(bounds[k], bounds[k - 1]);
+        }
+        return bounds;
+    }
+
+    /**
+     * @brief Scans one chunk, parsing each numeric field into its column fragment as it is read.
+     */
+    void scan(Chunk& chunk, const char* begin, const char* end, const vector<string>& columns, const vector<Kind>& kinds) const {
+        size_t num_cols = columns.size();
+        CsvScanner scanner(begin, end, options.delim);
+        chunk.begin = begin;
+        chunk.end = end;
+        chunk.kinds = kinds;
+        chunk.parsed.resize(num_cols);
+        for (size_t jdx = 0; jdx < num_cols; jdx++) {
+            chunk.parsed[jdx].name = columns[jdx];
+            chunk.parsed[jdx].dtype = kind_name(kinds[jdx]);
+            if (kinds[jdx] == STRING && options.encode_strings) {
+                chunk.parsed[jdx].encode();
+            }
+        }
+
+        vector<string_view> fields;
+        while (scanner.next_row(fields)) {
+            size_t row = chunk.num_rows + 1;
+            size_t max_distinct = dict_limit(chunk, row, scanner.position());
+            if (fields.size() > num_fields) {
+                chunk.error_row = row;
+                chunk.error = "Error: Expected " + to_string(num_fields) + " fields, saw " + to_string(fields.size());
+                return;
+            }
+            // rows with fewer fields are missing their last elements
+            fields.resize(num_fields);
+
+            for (size_t jdx = 0; jdx < num_cols; jdx++) {
+                string_view element = fields[source[jdx]];
+                Column& col = chunk.parsed[jdx];
+                if (chunk.kinds[jdx] == STRING) {
+                    append_text(col, element, max_distinct);
+                    continue;
+                }
+                if (element.length() == 0) {
+                    // missing element
+                    col.append_na();
+                    continue;
+                }
+
+                int64_t int_value;
+                double float_value;
+                if (chunk.kinds[jdx] == INT && parse_int(element, int_value)) {
+                    col.append(int_value);
+                    continue;
+                }
+                bool is_num = parse_float(element, float_value);
+                Kind needed = is_num ? FLOAT : STRING;
+                if (fixed[jdx] && needed > chunk.kinds[jdx]) {
+                    chunk.error_row = row;
+                    chunk.error = "Error: Invalid " + string(kind_name(chunk.kinds[jdx])) + " value '"
+                                  + string(element) + "' in column " + columns[jdx];
+                    return;
+                }
+                if (needed == STRING) {
+                    chunk.kinds[jdx] = STRING;
+                    reread_text(chunk, {jdx}, chunk.num_rows, max_distinct);
+                    append_text(col, element, max_distinct);
+                    continue;
+                }
+                if (chunk.kinds[jdx] == INT) {
+                    chunk.kinds[jdx] = FLOAT;
+                    col = col.astype("float");
+                }
+                col.append(float_value);
+            }
+            chunk.num_rows++;
+        }
+    }
+
+    /**
+     * @brief Brings every fragment of a chunk to its column's final dtype.
+     */
+    void finish(Chunk& chunk, const vector<Kind>& kinds) const {
+        // numeric fragments of columns another chunk found to be strings are read again as text
+        vector<size_t> widened;
+        for (size_t jdx = 0; jdx < kinds.size(); jdx++) {
+            if (kinds[jdx] == STRING && chunk.kinds[jdx] != STRING) {
+                widened.push_back(jdx);
+            }
+        }
+        reread_text(chunk, widened, chunk.num_rows, chunk.num_rows / dict_ratio);
+
+        for (size_t jdx = 0; jdx < kinds.size(); jdx++) {
+            Column& col = chunk.parsed[jdx];
+            if (kinds[jdx] == STRING) {
+                // stays encoded if the fragment has few enough distinct values
+                if (col.is_encoded() && col.categories().size() > chunk.num_rows / dict_ratio) {
+                    col.decode();
+                }
+            } else if (kinds[jdx] != chunk.kinds[jdx]) {
+                col = col.astype("float");
+            }
+        }
+    }
+
+    /**
+     * @brief Drops the rows of a parsed chunk that do not match filter.
+     */
+    static void keep_matching(Chunk& chunk, const vector<string>& columns, const Expr& filter) {
+        Bitmap mask = filter.evaluate([&](const string& name) -> const Column& {
+            auto it = find(columns.begin(), columns.end(), name);
+            if (it == columns.end()) {
+                throw std::out_of_range("Column not found: " + name);
+            }
+            return chunk.parsed[it - columns.begin()];
+        });
+        vector<size_t> rows = mask.indices();
+        for (Column& col : chunk.parsed) {
+            col = col.take(rows);
+        }
+        chunk.num_rows = rows.size();
+    }
+
+    /**
+     * @brief Returns how many distinct values a string fragment may hold while the chunk is scanned.
+     *
+     * The chunk's row count is extrapolated from the bytes consumed by the first rows, so a
+     * fragment that will end up with more than one distinct value per dict_ratio rows gives
+     * up its dictionary early instead of holding every value twice until finish().
+     */
+    static size_t dict_limit(const Chunk& chunk, size_t rows, const char* position) {
+        double consumed = static_cast<double>(position - chunk.begin);
+        double expected_rows = rows * (static_cast<double>(chunk.end - chunk.begin) / std::max(consumed, 1.0));
+        return std::max(min_dict_size, static_cast<size_t>(expected_rows) / dict_ratio);
+    }
+
+    /**
+     * @brief Appends one field to a string fragment, copying it into the column's buffer.
+     *
+     * An encoded fragment is decoded once it holds more than max_distinct distinct values.
+     */
+    static void append_text(Column& col, string_view element, size_t max_distinct) {
+        if (element.length() == 0) {
+            col.append_na();
+        } else {
+            col.append(element);
+        }
+        if (col.is_encoded() && col.categories().size() > max_distinct) {
+            col.decode();
+        }
+    }
+
+    /**
+     * @brief Replaces the fragments of the given columns with the text of the chunk's first rows.
+     *
+     * Used when a column turns out to hold strings after some of its values were parsed as
+     * numbers: the chunk is scanned again instead of keeping every field's text around.
+     */
+    void reread_text(Chunk& chunk, const vector<size_t>& targets, size_t rows, size_t max_distinct) const {
+        if (targets.empty()) {
+            return;
+        }
+        for (size_t jdx : targets) {
+            Column& col = chunk.parsed[jdx];
+            Column text;
+            text.name = col.name;
+            if (options.encode_strings) {
+                text.encode();
+            }
+            text.reserve(rows);
+            col = std::move(text);
+        }
+        CsvScanner scanner(chunk.begin, chunk.end, options.delim);
+        vector<string_view> fields;
+        for (size_t row = 0; row < rows && scanner.next_row(fields); row++) {
+            for (size_t jdx : targets) {
+                append_text(chunk.parsed[jdx], source[jdx] < fields.size() ? fields[source[jdx]] : string_view(), max_distinct);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Layout of the files written by DataFrame::save_binary().
+ *
+ * A file starts with a BinaryHeader, followed by one BinaryColumnEntry per column and
+ * the column names. Each column then stores its validity words and its values (int64 or
+ * double, or for strings num_rows + 1 uint64 offsets followed by the characters), every
+ * buffer starting on a 64-byte boundary. Entries hold absolute file offsets, so a single
+ * column can be read from a memory-mapped file without touching the others.
+ *
+ * @note Values are stored in the byte order of the machine that wrote the file; a
+ *       reader on a machine of the other byte order rejects the file.
+ */
+struct BinaryHeader {
+    char magic[8]; // "LPANDAS\0"
+    uint32_t byte_order; // binary_byte_order as written by the producer
+    uint32_t version;
+    uint64_t num_rows;
+    uint64_t num_cols;
+};
+
+struct BinaryColumnEntry {
+    uint64_t name_offset;
+    uint64_t name_length;
+    uint64_t dtype; // 0 = int, 1 = float, 2 = string
+    uint64_t validity_offset;
+    uint64_t offsets_offset; // string columns only
+    uint64_t data_offset;
+    uint64_t data_length; // in bytes
+    uint64_t zones_offset; // numeric columns: the zone map (see binary_zones_bytes()), or 0 if absent
+};
+
+constexpr char binary_magic[8] = {'L', 'P', 'A', 'N', 'D', 'A', 'S', '\0'};
+constexpr uint32_t binary_byte_order = 0x01020304;
+constexpr uint32_t binary_version = 1;
+constexpr uint64_t binary_alignment = 64;
+
+/**
+ * @brief Size of a stored zone map: block_rows, flags (bit 0 sorted, bit 1 complete),
+ *        then the per-block minimums and maximums, 8 bytes each.
+ */
+inline uint64_t binary_zones_bytes(uint64_t num_rows) {
+    uint64_t blocks = (num_rows + ZoneMap<int64_t>::block_rows - 1) / ZoneMap<int64_t>::block_rows;
+    return (2 + 2 * blocks) * sizeof(uint64_t);
+}
+
+/**
+ * @brief Mixes a 64-bit word into a hash (the splitmix64 finalizer).
+ */
+inline uint64_t hash_mix(uint64_t h, uint64_t word) {
+    h ^= word + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/**
+ * @brief A HyperLogLog sketch: estimates the number of distinct hashes added to it.
+ *
+ * Each 64-bit hash picks one of 2^precision registers with its top bits and keeps the
+ * longest run of leading zeros seen in the rest, so the sketch takes 16KB whatever the
+ * number of values, with a standard error of about 1.04 / sqrt(2^precision) (0.8%).
+ * Sketches of separate parts of the data combine with merge(), like ColumnStats.
+ */
+struct HyperLogLog {
+    static constexpr size_t precision = 14;
+    static constexpr size_t num_registers = size_t(1) << precision;
+    static constexpr size_t max_rank = 64 - precision + 1;
+
+    array<uint8_t, num_registers> registers{};
+
+    /**
+     * @brief Adds a well-mixed hash (e.g. from hash_mix()).
+     */
+    void add(uint64_t hash) {
+        size_t idx = hash >> (64 - precision);
+        // a sentinel bit bounds the run of zeros when the remaining bits are all clear
+        uint64_t rest = (hash << precision) | (uint64_t(1) << (precision - 1));
+        uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        registers[idx] = std::max(registers[idx], rank);
+    }
+
+    void merge(const HyperLogLog& other) {
+        for (size_t idx = 0; idx < num_registers; idx++) {
+            registers[idx] = std::max(registers[idx], other.registers[idx]);
+        }
+    }
+
+    /**
+     * @brief Returns the estimated number of distinct hashes added.
+     *
+     * Uses Ertl's improved estimator ("New cardinality estimation algorithms for
+     * HyperLogLog sketches", 2017), which, unlike the original one, needs no separate
+     * small-range correction and has no bias where that correction hands over.
+     */
+    double estimate() const {
+        constexpr double m = num_registers;
+        array<size_t, max_rank + 1> hist{};
+        for (uint8_t rank : registers) {
+            hist[rank]++;
+        }
+        if (hist[0] == num_registers) {
+            return 0;
+        }
+        double z = m * tau(1 - hist[max_rank] / m);
+        for (size_t k = max_rank - 1; k >= 1; k--) {
+            z = 0.5 * (z + hist[k]);
+        }
+        z += m * sigma(hist[0] / m);
+        return m * m / (2 * std::log(2.0)) / z;
+    }
+
+private:
+    static double sigma(double x) {
+        if (x == 1) {
+            return numeric_limits<double>::infinity();
+        }
+        double y = 1;
+        double z = x;
+        for (double previous = -1; z != previous; ) {
+            x *= x;
+            previous = z;
+            z += x * y;
+            y += y;
+        }
+        return z;
+    }
+
+    static double tau(double x) {
+        if (x == 0 || x == 1) {
+            return 0;
+        }
+        double y = 1;
+        double z = 1 - x;
+        for (double previous = -1; z != previous; ) {
+            x = std::sqrt(x);
+            previous = z;
+            y *= 0.5;
+            z -= (1 - x) * (1 - x) * y;
+        }
+        return z / 3;
+    }
+};
+
+/**
+ * @brief An open-addressing hash table that assigns dense ids to fixed-width keys.
+ *
+ * Keys are `width` 64-bit words, stored back to back in insertion order so group i's key
+ * sits at words [i * width, (i + 1) * width). Each slot packs the upper 32 bits of the
+ * key's hash with its id + 1 into one word, so probing usually touches a single cache line
+ * and key words are only compared when the hash tags match. The table stays at most half
+ * full, with linear probing.
+ */
+class GroupTable {
+public:
+    static constexpr uint32_t none = numeric_limits<uint32_t>::max();
+
+    explicit GroupTable(size_t width)
+    : width(width), slots(64, 0), mask(63) {}
+
+    /**
+     * @brief Returns the id of key, adding it as a new group if it is not in the table.
+     *
+     * @param key Pointer to width words
+     * @param hash Hash of the key, as computed by hash_key()
+     */
+    uint32_t find_or_insert(const uint64_t* key, uint64_t hash) {
+        uint64_t tag = hash & ~uint64_t(0xffffffff);
+        for (size_t pos = hash & mask; ; pos = (pos + 1) & mask) {
+            uint64_t slot = slots[pos];
+            if (slot == 0) {
+                uint32_t id = static_cast<uint32_t>(num_groups++);
+                keys.insert(keys.end(), key, key + width);
+                hashes.push_back(hash);
+                slots[pos] = tag | (uint64_t(id) + 1);
+                if (num_groups * 2 > slots.size()) {
+                    grow();
+                }
+                return id;
+            }
+            if ((slot & ~uint64_t(0xffffffff)) == tag) {
+                uint32_t id = static_cast<uint32_t>((slot & 0xffffffff) - 1);
+                if (std::equal(key, key + width, keys.begin() + id * width)) {
+                    return id;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the id of key, or GroupTable::none if it is not in the table.
+     */
+    uint32_t find(const uint64_t* key, uint64_t hash) const {
+        uint64_t tag = hash & ~uint64_t(0xffffffff);
+        for (size_t pos = hash & mask; ; pos = (pos + 1) & mask) {
+            uint64_t slot = slots[pos];
+            if (slot == 0) {
+                return none;
+            }
+            if ((slot & ~uint64_t(0xffffffff)) == tag) {
+                uint32_t id = static_cast<uint32_t>((slot & 0xffffffff) - 1);
+                if (std::equal(key, key + width, keys.begin() + id * width)) {
+                    return id;
+                }
+            }
+        }
+    }
+
+    uint64_t hash_key(const uint64_t* key) const {
+        uint64_t h = 0;
+        for (size_t c = 0; c < width; c++) {
+            h = hash_mix(h, key[c]);
+        }
+        return h;
+    }
+
+    size_t size() const {
+        return num_groups;
+    }
+
+    const uint64_t* key(size_t id) const {
+        return keys.data() + id * width;
+    }
+
+    uint64_t hash(size_t id) const {
+        return hashes[id];
+    }
+
+private:
+    size_t width;
+    vector<uint64_t> slots; // hash tag in the upper half, id + 1 in the lower half, 0 = empty
+    size_t mask;
+    vector<uint64_t> keys;
+    vector<uint64_t> hashes; // hash of each group's key, reused when the table grows
+    size_t num_groups = 0;
+
+    void grow() {
+        vector<uint64_t> bigger(slots.size() * 2, 0);
+        size_t bigger_mask = bigger.size() - 1;
+        for (size_t id = 0; id < num_groups; id++) {
+            size_t pos = hashes[id] & bigger_mask;
+            while (bigger[pos] != 0) {
+                pos = (pos + 1) & bigger_mask;
+            }
+            bigger[pos] = (hashes[id] & ~uint64_t(0xffffffff)) | (uint64_t(id) + 1);
+        }
+        slots.swap(bigger);
+        mask = bigger_mask;
+    }
+};
+
+/**
+ * @brief Assigns dense ids to strings, with the same open-addressing layout as GroupTable.
+ *
+ * The table stores views, so the strings must outlive it.
+ */
+class StringIds {
+public:
+    StringIds() : slots(64, 0), mask(63) {}
+
+    uint32_t find_or_insert(string_view value) {
+        uint64_t hash = hash_mix(0, std::hash<string_view>()(value));
+        uint64_t tag = hash & ~uint64_t(0xffffffff);
+        for (size_t pos = hash & mask; ; pos = (pos + 1) & mask) {
+            uint64_t slot = slots[pos];
+            if (slot == 0) {
+                uint32_t id = static_cast<uint32_t>(values.size());
+                values.push_back(value);
+                hashes.push_back(hash);
+                slots[pos] = tag | (uint64_t(id) + 1);
+                if (values.size() * 2 > slots.size()) {
+                    grow();
+                }
+                return id;
+            }
+            if ((slot & ~uint64_t(0xffffffff)) == tag) {
+                uint32_t id = static_cast<uint32_t>((slot & 0xffffffff) - 1);
+                if (values[id] == value) {
+                    return id;
+                }
+            }
+        }
+    }
+
+private:
+    vector<uint64_t> slots;
+    size_t mask;
+    vector<string_view> values;
+    vector<uint64_t> hashes;
+
+    void grow() {
+        vector<uint64_t> bigger(slots.size() * 2, 0);
+        size_t bigger_mask = bigger.size() - 1;
+        for (size_t id = 0; id < values.size(); id++) {
+            size_t pos = hashes[id] & bigger_mask;
+            while (bigger[pos] != 0) {
+                pos = (pos + 1) & bigger_mask;
+            }
+            bigger[pos] = (hashes[id] & ~uint64_t(0xffffffff)) | (uint64_t(id) + 1);
+        }
+        slots.swap(bigger);
+        mask = bigger_mask;
+    }
+};
+
+inline vector<size_t> Column::count_distinct(vector<size_t>* first_rows) const {
+    const Buffers& store = data();
+    vector<size_t> counts;
+    auto add = [&](size_t id, size_t row) {
+        if (id == counts.size()) {
+            counts.push_back(0);
+            if (first_rows) {
+                first_rows->push_back(row);
+            }
+        }
+        counts[id]++;
+    };
+    if (dtype == "string" && store.encoded) {
+        // the codes already number the values; renumber them in order of first appearance
+        vector<uint32_t> id_of(store.dict.size(), GroupTable::none);
+        each_present([&](size_t row) {
+            uint32_t& id = id_of[store.dict_codes[row]];
+            if (id == GroupTable::none) {
+                id = static_cast<uint32_t>(counts.size());
+            }
+            add(id, row);
+        });
+    } else if (dtype == "string") {
+        StringIds ids;
+        each_present([&](size_t row) {
+            add(ids.find_or_insert(store.str_data[row]), row);
+        });
+    } else {
+        GroupTable table(1);
+        visit_numeric([&](const auto& values) {
+            using T = typename decay_t<decltype(values)>::value_type;
+            each_present([&](size_t row) {
+                T x = values[row];
+                if constexpr (is_floating_point_v<T>) {
+                    if (x != x) {
+                        return;
+                    }
+                    if (x == 0) {
+                        x = 0; // -0.0
+                    }
+                }
+                uint64_t key;
+                memcpy(&key, &x, sizeof(key));
+                add(table.find_or_insert(&key, table.hash_key(&key)), row);
+            });
+        });
+    }
+    return counts;
+}
+
+inline Column Column::unique() const {
+    vector<size_t> first_rows;
+    count_distinct(&first_rows);
+    return take(first_rows);
+}
+
+inline size_t Column::nunique() const {
+    return count_distinct(nullptr).size();
+}
+
+inline size_t Column::nunique_approx() const {
+    constexpr size_t task_rows = 1 << 18;
+    const Buffers& store = data();
+    size_t n = size();
+    size_t num_tasks = (n + task_rows - 1) / task_rows;
+    vector<uint64_t> dict_hashes;
+    if (dtype == "string" && store.encoded) {
+        for (const string& value : store.dict) {
+            dict_hashes.push_back(hash_mix(0, std::hash<string_view>()(value)));
+        }
+    }
+
+    vector<HyperLogLog> partial(num_tasks);
+    parallel_for(num_tasks, n >= parallel_min_rows ? 0 : 1, [&](size_t task) {
+        HyperLogLog& sketch = partial[task];
+        const vector<uint64_t>& words = store.validity.data();
+        auto each_row = [&](auto&& f) {
+            for (size_t w = task * task_rows / 64; w < std::min(words.size(), (task + 1) * task_rows / 64); w++) {
+                for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+                    f(w * 64 + __builtin_ctzll(word));
+                }
+            }
+        };
+        if (dtype == "string" && store.encoded) {
+            each_row([&](size_t row) {
+                sketch.add(dict_hashes[store.dict_codes[row]]);
+            });
+        } else if (dtype == "string") {
+            each_row([&](size_t row) {
+                sketch.add(hash_mix(0, std::hash<string_view>()(store.str_data[row])));
+            });
+        } else {
+            visit_numeric([&](const auto& values) {
+                using T = typename decay_t<decltype(values)>::value_type;
+                each_row([&](size_t row) {
+                    T x = values[row];
+                    if constexpr (is_floating_point_v<T>) {
+                        if (x != x) {
+                            return;
+                        }
+                        if (x == 0) {
+                            x = 0;
+                        }
+                    }
+                    uint64_t key;
+                    memcpy(&key, &x, sizeof(key));
+                    sketch.add(hash_mix(0, key));
+                });
+            });
+        }
+    });
+
+    HyperLogLog sketch;
+    for (const HyperLogLog& part : partial) {
+        sketch.merge(part);
+    }
+    return static_cast<size_t>(std::llround(sketch.estimate()));
+}
+
+inline vector<double> Column::quantile(const vector<double>& qs) const {
+    if (dtype != "int" && dtype != "float") {
+        throw invalid_argument("Invalid type: Column::quantile() expects `dtype` to be int or float");
+    }
+    for (double q : qs) {
+        if (!(q >= 0 && q <= 1)) {
+            throw invalid_argument("Invalid argument: Column::quantile() expects q between 0 and 1");
+        }
+    }
+    const Buffers& store = data();
+    bool in_order;
+    {
+        lock_guard<mutex> guard(store.summary.lock);
+        in_order = store.summary.sorted == 1 && store.validity.count() == size()
+            && (dtype == "int" || (store.summary.float_zones && store.summary.float_zones->complete));
+    }
+
+    vector<double> result(qs.size(), numeric_limits<double>::quiet_NaN());
+    visit_numeric([&](const auto& values) {
+        using T = typename decay_t<decltype(values)>::value_type;
+        vector<T> present;
+        if (!in_order) {
+            present.reserve(store.validity.count());
+            each_present([&](size_t row) {
+                if (values[row] == values[row]) {
+                    present.push_back(values[row]);
+                }
+            });
+        }
+        const vector<T>& v = in_order ? values : present;
+        size_t m = v.size();
+        if (m == 0) {
+            return;
+        }
+
+        // the ranks needed, ascending; each selection only searches past the one before
+        vector<size_t> ranks;
+        for (double q : qs) {
+            size_t lo = static_cast<size_t>(std::floor(q * (m - 1)));
+            ranks.push_back(lo);
+            ranks.push_back(std::min(m - 1, lo + 1));
+        }
+        sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        if (!in_order) {
+            size_t from = 0;
+            for (size_t rank : ranks) {
+                nth_element(present.begin() + from, present.begin() + rank, present.end());
+                from = rank + 1;
+            }
+        }
+
+        for (size_t k = 0; k < qs.size(); k++) {
+            double pos = qs[k] * (m - 1);
+            size_t lo = static_cast<size_t>(std::floor(pos));
+            double low = static_cast<double>(v[lo]);
+            double high = static_cast<double>(v[std::min(m - 1, lo + 1)]);
+            double frac = pos - lo;
+            result[k] = frac == 0 ? low : low + (high - low) * frac;
+        }
+    });
+    return result;
+}
+
+inline double Column::quantile(double q) const {
+    return quantile(vector<double>{q})[0];
+}
+
+inline double Column::median() const {
+    return quantile(0.5);
+}
+
+class DataFrameView;
+class GroupBy;
+class SortedView;
+class LazyFrame;
+class CsvChunks;
+
+/**
+ * @brief A DataFrame class for handling tabular data similar to pandas DataFrame.
+ * 
+ * The DataFrame class provides functionality to load CSV files, manipulate data,
+ * perform filtering operations, and save results. It automatically detects column
+ * data types and provides various data analysis methods.
+ */
+class DataFrame {
+private:
+    vector<Column> col_data; // in schema order, parallel to columns
+    unordered_map<string, size_t> col_index; // column name -> position in col_data
+    string file_dir;
+public:
+    vector<string> columns;
+
+    /**
+     * @brief Default constructor for creating an empty DataFrame.
+     */
+    DataFrame() = default;
+    
+    /**
+     * @brief Copy constructor for creating a DataFrame from another DataFrame.
+     * 
+     * Columns share their buffers with the originals until either side modifies them
+     * (see Column), so a copy costs O(columns) rather than O(cells).
+     *
+     * @param other The DataFrame to copy from
+     */
+    DataFrame(const DataFrame& other) = default;
+    DataFrame(DataFrame&& other) = default;
+    DataFrame& operator=(const DataFrame& other) = default;
+    DataFrame& operator=(DataFrame&& other) = default;
+
+    /**
+     * @brief Materializes a filtered view into a new DataFrame.
+     * 
+     * @param view The view whose selected rows are copied
+     */
+    DataFrame(const DataFrameView& view);
+
+    /**
+     * @brief Materializes a sort into a new DataFrame.
+     *
+     * @param view The sort whose rows are gathered, in sorted order
+     */
+    DataFrame(const SortedView& view);
+
+    /**
+     * @brief Constructor that loads data from a CSV file.
+     * 
+     * @param new_file_dir Path to the CSV file to load
+     * @param options Delimiter and number of parsing threads (see CsvOptions)
+     * @throws runtime_error If the file cannot be found or opened, or a row has more fields than the header
+     * @note Automatically detects column data types (int, float, or string)
+     * @note Handles missing values and quoted fields in CSV files
+     * @note The file is memory-mapped and scanned once; fields are parsed straight into
+     *       the typed column buffers, in parallel chunks when options.num_threads != 1
+     * @note Gzip and zstd files are decompressed on a background thread while they are
+     *       parsed, when built with LESSER_PANDAS_ZLIB or LESSER_PANDAS_ZSTD (see Decompressor)
+     */
+    DataFrame(string new_file_dir, const CsvOptions& options = CsvOptions()) {
+        LP_PROFILE_SCOPE("read_csv");
+        file_dir = new_file_dir;
+        CsvReader reader(file_dir, options);
+
+        reader.read(columns, col_data);
+        index_columns();
+        LP_PROFILE_MEMORY(memory_bytes());
+    }
+
+    /**
+     * @brief Loads a DataFrame written by save_binary().
+     *
+     * The file is memory-mapped and only the requested columns are read: their typed
+     * buffers and validity words are copied with a single memcpy each, and nothing is
+     * parsed or inferred, so reloading costs little more than reading the bytes.
+     *
+     * @param path Path to the binary file
+     * @param usecols Names of the columns to load, kept in file order (empty = all columns)
+     * @return The stored DataFrame
+     * @throws runtime_error If the file cannot be found or is not a valid binary DataFrame
+     * @throws std::out_of_range If a name in usecols is not in the file
+     */
+    static DataFrame read_binary(const string& path, const vector<string>& usecols = {}) {
+        return read_binary_where(path, usecols, nullptr);
+    }
+
+    /**
+     * @brief Reads a CSV file a bounded number of rows at a time; see CsvChunks.
+     *
+     * @param path Path to the CSV file
+     * @param chunk_rows Maximum number of rows in each chunk
+     * @param options How the file is read, as for DataFrame(path, options)
+     * @return A CsvChunks whose next() returns the chunks in file order
+     * @throws runtime_error If the file cannot be found or opened
+     * @throws invalid_argument If chunk_rows is 0
+     */
+    static CsvChunks read_csv_chunks(const string& path, size_t chunk_rows, const CsvOptions& options = CsvOptions());
+
+    /**
+     * @brief Starts a lazy query over this DataFrame; see LazyFrame.
+     *
+     * @return A LazyFrame that refers to this DataFrame, which must outlive it
+     */
+    LazyFrame lazy() const;
+
+    /**
+     * @brief Starts a lazy query over a CSV file; see LazyFrame.
+     *
+     * Only the header is read here. collect() parses just the columns the query uses and
+     * drops the rows its filters reject as each chunk is parsed.
+     *
+     * @param path Path to the CSV file
+     * @param options How the file is read, as for DataFrame(path, options)
+     * @return A LazyFrame reading the file
+     */
+    static LazyFrame scan_csv(const string& path, const CsvOptions& options = CsvOptions());
+
+    /**
+     * @brief Starts a lazy query over a file written by save_binary(); see LazyFrame.
+     *
+     * @param path Path to the binary file
+     * @return A LazyFrame reading the file
+     */
+    static LazyFrame scan_binary(const string& path);
+
+    /**
+     * @brief Returns the number of data rows in the DataFrame.
+     */
+    size_t num_rows() const {
+        return col_data.empty() ? 0 : col_data[0].size();
+    }
+
+    /**
+     * @brief Prints the DataFrame with various formatting options.
+     * 
+     * @param rows_cnt Number of rows to print (0 = print all rows)
+     * @param is_tail If 1, prints from the end; if 0, prints from the beginning
+     * @param cols Vector of column names to print (empty = print all columns)
+     * @throws std::out_of_range If any specified column is not found
+     * @note Only the printed rows are formatted, straight from the column buffers
+     */
+    void print(int rows_cnt = 0, int is_tail = 0, vector<string> cols = {}) const {
+        print_rows(rows_cnt, is_tail, cols, nullptr);
+    }
+
+    /**
+     * @brief Displays the first N rows of the DataFrame.
+     * 
+     * @param rows_cnt Number of rows to display from the beginning (default: 5)
+     */
+    void head(int rows_cnt = 5) const {
+        print(rows_cnt);
+    };
+
+    /**
+     * @brief Displays the last N rows of the DataFrame.
+     * 
+     * @param rows_cnt Number of rows to display from the end (default: 5)
+     */
+    void tail(int rows_cnt = 5) const {
+        print(rows_cnt, 1);
+    };
+
+    /**
+     * @brief Renames columns in the DataFrame.
+     * 
+     * @param vec Vector of pairs containing (old_name, new_name) mappings
+     * @throws std::out_of_range If any old column name is not found
+     * @throws invalid_argument If a new name is already used by another column
+     */
+    void rename(vector<pair<string, string>> vec) {
+        for(pair<string, string> col_pair : vec) {
+            string old_col_name = col_pair.first;
+            string new_col_name = col_pair.second;
+
+            auto it = col_index.find(old_col_name);
+            if (it == col_index.end()) {
+                throw std::out_of_range("Column not found!");
+            }
+            if (new_col_name == old_col_name) {
+                continue;
+            }
+            if (col_index.count(new_col_name)) {
+                throw invalid_argument("Column already exists: " + new_col_name);
+            }
+
+            size_t pos = it->second;
+            col_index.erase(it);
+            col_index[new_col_name] = pos;
+            col_data[pos].name = new_col_name;
+            columns[pos] = new_col_name;
+        }
+    }
+
+    /**
+     * @brief Fills all missing values in the DataFrame with a specified value.
+     * 
+     * @tparam T The type of the fill value (int, double, or string)
+     * @param x The value to use for filling missing entries
+     * @note Numeric values apply to all columns in the DataFrame, string values only
+     *       to string columns
+     */
+    template <typename T>
+    void fillna(const T& x) {
+        LP_PROFILE_SCOPE("fillna");
+        LP_PROFILE_ROWS(num_rows(), 0);
+        for (Column& col : col_data) {
+            if constexpr (!is_arithmetic_v<T>) {
+                if (col.dtype != "string") {
+                    continue;
+                }
+            }
+            col.fillna(x);
+        }
+    }
+
+    /**
+     * @brief Removes rows from the DataFrame where the specified column has missing values.
+     * 
+     * @param col The name of the column to check for missing values
+     * @throws std::out_of_range If the column name is not found
+     * @note Removes entire rows across all columns when the specified column has empty values
+     */
+    template <typename S, typename = enable_if_t<is_convertible_v<const S&, string>>>
+    void dropna(const S& col) {
+        dropna(vector<string>{string(col)});
+    }
+
+    /**
+     * @brief Removes rows with missing values.
+     *
+     * The rows to keep are found once, from the validity bitmaps of the subset columns, and
+     * every column is then compacted in a single stable pass (in parallel across columns on
+     * long frames).
+     *
+     * @param subset Names of the columns to check (empty = all columns)
+     * @param how "any" drops a row if any subset column is missing, "all" only if all of them are
+     * @param thresh If positive, keeps the rows with at least this many present values in the
+     *               subset instead, ignoring how
+     * @throws std::out_of_range If a subset column is not found
+     * @throws invalid_argument If how is not "any" or "all"
+     * @note NaN counts as missing in float columns, as in count()
+     */
+    void dropna(const vector<string>& subset = {}, const string& how = "any", size_t thresh = 0) {
+        LP_PROFILE_SCOPE("dropna");
+        LP_PROFILE_ROWS(num_rows(), 0);
+        if (how != "any" && how != "all") {
+            throw invalid_argument("Invalid argument: DataFrame::dropna() expects `how` to be any or all");
+        }
+        vector<const Column*> targets;
+        for (const string& col_name : subset.empty() ? columns : subset) {
+            const Column* col = find_column(col_name);
+            if (!col) {
+                throw std::out_of_range("Column not found!");
+            }
+            targets.push_back(col);
+        }
+
+        size_t n = num_rows();
+        auto present = [](const Column& col) {
+            Bitmap bits = col.valid();
+            if (col.dtype == "float") {
+                const vector<double>& values = col.float_values();
+                for (size_t idx = 0; idx < values.size(); idx++) {
+                    if (values[idx] != values[idx]) {
+                        bits.set(idx, false);
+                    }
+                }
+            }
+            return bits;
+        };
+
+        vector<size_t> kept_idx;
+        if (thresh > 0) {
+            vector<uint32_t> counts(n, 0);
+            for (const Column* col : targets) {
+                for (size_t idx : present(*col).indices()) {
+                    counts[idx]++;
+                }
+            }
+            for (size_t idx = 0; idx < n; idx++) {
+                if (counts[idx] >= thresh) {
+                    kept_idx.push_back(idx);
+                }
+            }
+        } else if (!targets.empty()) {
+            Bitmap keep = present(*targets[0]);
+            for (size_t c = 1; c < targets.size(); c++) {
+                keep = how == "any" ? std::move(keep) & present(*targets[c]) : std::move(keep) | present(*targets[c]);
+            }
+            kept_idx = keep.indices();
+        }
+        if (kept_idx.size() == n) {
+            return;
+        }
+
+        parallel_for(col_data.size(), n >= parallel_min_rows ? 0 : 1, [&](size_t c) {
+            col_data[c] = col_data[c].take(kept_idx);
+        });
+    }
+
+    /**
+     * @brief Computes an arithmetic expression of the columns in one fused pass.
+     *
+     * `df.eval((Expr::col("a") * Expr::col("b") + Expr::col("c")) / Expr::col("d"))` reads
+     * each column once, a block of rows at a time, and allocates only the result (see
+     * ColumnProgram), where the same chain of Column operators makes a temporary column
+     * per operator.
+     *
+     * @param expr The expression; see Expr::compute() for its types and missing values
+     * @return The values, as an unnamed column (see assign())
+     * @throws std::out_of_range If a column is not found
+     * @throws invalid_argument If expr is a predicate, or a column it computes with is not "int" or "float"
+     */
+    Column eval(const Expr& expr) const {
+        LP_PROFILE_SCOPE("eval");
+        LP_PROFILE_ROWS(num_rows(), 0);
+        return expr.compute([&](const string& col_name) -> const Column& {
+            const Column* found = find_column(col_name);
+            if (!found) {
+                throw std::out_of_range("Column not found: " + col_name);
+            }
+            return *found;
+        });
+    }
+
+    /**
+     * @brief Adds a column at the end, or replaces the column of the same name.
+     *
+     * @param col_name Name of the column (col is renamed to it)
+     * @param col The values, one per row
+     * @throws invalid_argument If the DataFrame has columns and col's length differs from num_rows()
+     */
+    void assign(const string& col_name, Column col) {
+        if (!col_data.empty() && col.size() != num_rows()) {
+            throw invalid_argument("Invalid argument: DataFrame::assign() expects one value per row");
+        }
+        col.name = col_name;
+        auto it = col_index.find(col_name);
+        if (it != col_index.end()) {
+            col_data[it->second] = std::move(col);
+            return;
+        }
+        col_index[col_name] = col_data.size();
+        columns.push_back(col_name);
+        col_data.push_back(std::move(col));
+    }
+
+    /**
+     * @brief Adds or replaces a column with the values of an expression; see eval().
+     */
+    void assign(const string& col_name, const Expr& expr) {
+        assign(col_name, eval(expr));
+    }
+
+    /**
+     * @brief Summarizes the numeric columns: count, null_count, mean, std, min, max, sum and sorted.
+     *
+     * Each column is reduced once (see Column::stats()) and the results are cached in
+     * the column, so describing a frame again, or asking for its mean or max afterwards,
+     * does not rescan unchanged columns.
+     *
+     * @return A DataFrame with a "statistic" column naming each row and one float column
+     *         per int or float column; sorted is 1 if the present values are in
+     *         ascending order (see Column::is_sorted()), and statistics that are
+     *         undefined (e.g. the mean of no values) are missing
+     */
+    DataFrame describe() const {
+        static const vector<string> names = {"count", "null_count", "mean", "std", "min", "max", "sum", "sorted"};
+        DataFrame result;
+        Column statistic;
+        statistic.name = "statistic";
+        for (const string& name : names) {
+            statistic.append(name);
+        }
+        result.columns.push_back(statistic.name);
+        result.col_data.push_back(std::move(statistic));
+
+        for (const Column& col : col_data) {
+            if (col.dtype == "string") {
+                continue;
+            }
+            // stats() also settles is_sorted(), so each column is read once
+            ColumnStats stats = col.stats();
+            double values[] = {
+                static_cast<double>(stats.count), static_cast<double>(col.size() - stats.count),
+                stats.mean(), stats.std(), stats.min, stats.max, stats.sum, col.is_sorted() ? 1.0 : 0.0
+            };
+            Column out;
+            out.name = col.name;
+            out.dtype = "float";
+            for (double value : values) {
+                if (value != value) {
+                    out.append_na();
+                } else {
+                    out.append(value);
+                }
+            }
+            result.columns.push_back(out.name);
+            result.col_data.push_back(std::move(out));
+        }
+        result.index_columns();
+        return result;
+    }
+
+    /**
+     * @brief Reports how much memory each column holds; see Column::memory_usage().
+     *
+     * @return A DataFrame with one row per column: its name ("column"), "dtype" and
+     *         footprint in "bytes" (int)
+     */
+    DataFrame memory_usage() const {
+        Column name;
+        name.name = "column";
+        Column dtype;
+        dtype.name = "dtype";
+        Column bytes;
+        bytes.name = "bytes";
+        bytes.dtype = "int";
+        for (const Column& col : col_data) {
+            name.append(col.name);
+            dtype.append(col.dtype);
+            bytes.append(col.memory_usage());
+        }
+        DataFrame result;
+        for (Column* col : {&name, &dtype, &bytes}) {
+            result.columns.push_back(col->name);
+            result.col_data.push_back(std::move(*col));
+        }
+        result.index_columns();
+        return result;
+    }
+
+    /**
+     * @brief Returns the total of memory_usage() over the columns, in bytes.
+     */
+    size_t memory_bytes() const {
+        size_t bytes = 0;
+        for (const Column& col : col_data) {
+            bytes += col.memory_usage();
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Saves the DataFrame to a CSV file with customizable options.
+     *
+     * This function allows saving the DataFrame to a specified file with various options:
+     * - Custom separator for columns.
+     * - Option to include or exclude column headers.
+     * - Option to include or exclude row indices.
+     * - Replace missing values with a custom string.
+     * - Save only specific columns if specified.
+     *
+     * Rows are formatted into large buffers, in parallel blocks, and written in file order
+     * with a few large writes. Fields containing the separator, a quote or a line break
+     * are quoted as in RFC 4180, so the file loads back into the same DataFrame.
+     *
+     * @param output_file The path to the output file where the DataFrame will be saved.
+     * @param index Whether to include row indices in the output file (default: true).
+     * @param sep The separator to use between columns (default: ",").
+     * @param header Whether to include column headers in the output file (default: true).
+     * @param na_rep The string to replace missing values (default: "").
+     * @param selected_columns A vector of column names to save. If empty, all columns are saved (default: {}).
+     * @param num_threads Threads used to format rows (0 = all of the thread pool, the default).
+     * @param append Whether to add the rows to the end of the file instead of replacing it;
+     *               the header is then only written if the file is new or empty, and with
+     *               `index` the row indices continue after the last one in the file (default: false).
+     * @throws std::runtime_error If the file cannot be opened or written.
+     * @throws std::out_of_range If any of the specified columns in `selected_columns` do not exist.
+     */
+    void save_to_csv(
+        const string& output_file,
+        bool index = true,
+        const string& sep = ",",
+        bool header = true,
+        const string& na_rep = "",
+        const vector <string>& selected_columns = {},
+        size_t num_threads = 0,
+        bool append = false
+    ) const {
+        write_csv(output_file, index, sep, header, na_rep, selected_columns, nullptr, num_threads, append);
+    }
+
+    /**
+     * @brief Saves the DataFrame in a binary columnar file that read_binary() loads back.
+     *
+     * Each column is stored as its typed buffer and validity bitmap with the schema and
+     * per-column offsets up front (see BinaryHeader), so reloading needs no parsing or
+     * dtype inference and can skip columns that are not needed.
+     *
+     * @param output_file The path to the output file
+     * @param selected_columns Names of the columns to save (empty = all columns)
+     * @throws std::runtime_error If the file cannot be opened or written
+     * @throws std::out_of_range If any of the specified columns do not exist
+     */
+    void save_binary(const string& output_file, const vector<string>& selected_columns = {}) const {
+        LP_PROFILE_SCOPE("save_binary");
+        const vector<string>& names = selected_columns.empty() ? columns : selected_columns;
+        vector<const Column*> save_cols;
+        for (const string& col_name : names) {
+            const Column* found = find_column(col_name);
+            if (!found) {
+                throw std::out_of_range("Column not found: " + col_name);
+            }
+            save_cols.push_back(found);
+        }
+
+        std::filesystem::path file_path(output_file);
+        if (!file_path.parent_path().empty()) {
+            std::filesystem::create_directories(file_path.parent_path());
+        }
+        ofstream file(output_file, ios::binary);
+        if (!file) {
+            throw runtime_error("Error: Unable to open file for writing!");
+        }
+
+        size_t n = num_rows();
+        auto align = [](uint64_t offset) {
+            return (offset + binary_alignment - 1) / binary_alignment * binary_alignment;
+        };
+
+        // lay out the file: header, directory, names, then the aligned column buffers
+        vector<BinaryColumnEntry> entries(save_cols.size());
+        vector<vector<uint64_t>> str_offsets(save_cols.size());
+        uint64_t offset = sizeof(BinaryHeader) + entries.size() * sizeof(BinaryColumnEntry);
+        for (size_t jdx = 0; jdx < save_cols.size(); jdx++) {
+            entries[jdx].name_offset = offset;
+            entries[jdx].name_length = save_cols[jdx]->name.size();
+            offset += save_cols[jdx]->name.size();
+        }
+        for (size_t jdx = 0; jdx < save_cols.size(); jdx++) {
+            const Column& col = *save_cols[jdx];
+            BinaryColumnEntry& entry = entries[jdx];
+            entry.dtype = col.dtype == "int" ? 0 : col.dtype == "float" ? 1 : 2;
+            entry.validity_offset = offset = align(offset);
+            offset += (n + 63) / 64 * sizeof(uint64_t);
+            if (entry.dtype == 2 && !col.is_encoded()) {
+                // a plain column's buffers are already in the file layout
+                entry.offsets_offset = offset = align(offset);
+                offset += (n + 1) * sizeof(uint64_t);
+                entry.data_length = col.str_values().char_data().size();
+            } else if (entry.dtype == 2) {
+                vector<uint64_t>& offs = str_offsets[jdx];
+                offs.reserve(n + 1);
+                offs.push_back(0);
+                for (size_t idx = 0; idx < n; idx++) {
+                    offs.push_back(offs.back() + col.str_at(idx).size());
+                }
+                entry.offsets_offset = offset = align(offset);
+                offset += offs.size() * sizeof(uint64_t);
+                entry.data_length = offs.back();
+            } else {
+                entry.data_length = n * 8;
+            }
+            entry.data_offset = offset = align(offset);
+            offset += entry.data_length;
+            if (entry.dtype != 2) {
+                entry.zones_offset = offset = align(offset);
+                offset += binary_zones_bytes(n);
+            }
+        }
+
+        uint64_t written = 0;
+        auto put = [&](const void* data, size_t bytes) {
+            file.write(static_cast<const char*>(data), bytes);
+            written += bytes;
+        };
+        auto pad_to = [&](uint64_t target) {
+            static const char zeros[binary_alignment] = {};
+            put(zeros, target - written);
+        };
+
+        BinaryHeader head;
+        memcpy(head.magic, binary_magic, sizeof(binary_magic));
+        head.byte_order = binary_byte_order;
+        head.version = binary_version;
+        head.num_rows = n;
+        head.num_cols = save_cols.size();
+        put(&head, sizeof(head));
+        put(entries.data(), entries.size() * sizeof(BinaryColumnEntry));
+        for (const Column* col : save_cols) {
+            put(col->name.data(), col->name.size());
+        }
+        for (size_t jdx = 0; jdx < save_cols.size(); jdx++) {
+            const Column& col = *save_cols[jdx];
+            const BinaryColumnEntry& entry = entries[jdx];
+            pad_to(entry.validity_offset);
+            put(col.valid().data().data(), col.valid().data().size() * sizeof(uint64_t));
+            // so filters on the reloaded column can skip blocks without rebuilding it
+            auto put_zones = [&](const auto& zones) {
+                uint64_t meta[2] = {ZoneMap<int64_t>::block_rows, uint64_t(zones.sorted) | uint64_t(zones.complete) << 1};
+                pad_to(entry.zones_offset);
+                put(meta, sizeof(meta));
+                put(zones.min.data(), zones.num_blocks() * 8);
+                put(zones.max.data(), zones.num_blocks() * 8);
+            };
+            if (entry.dtype == 0) {
+                pad_to(entry.data_offset);
+                put(col.int_values().data(), entry.data_length);
+                put_zones(col.zone_map<int64_t>());
+            } else if (entry.dtype == 1) {
+                pad_to(entry.data_offset);
+                put(col.float_values().data(), entry.data_length);
+                put_zones(col.zone_map<double>());
+            } else if (!col.is_encoded()) {
+                pad_to(entry.offsets_offset);
+                put(col.str_values().offset_data().data(), (n + 1) * sizeof(uint64_t));
+                pad_to(entry.data_offset);
+                put(col.str_values().char_data().data(), entry.data_length);
+            } else {
+                pad_to(entry.offsets_offset);
+                put(str_offsets[jdx].data(), str_offsets[jdx].size() * sizeof(uint64_t));
+                pad_to(entry.data_offset);
+                for (size_t idx = 0; idx < n; idx++) {
+                    string_view value = col.str_at(idx);
+                    put(value.data(), value.size());
+                }
+            }
+        }
+
+        LP_PROFILE_ROWS(num_rows(), written);
+        file.close();
+        if (!file) {
+            throw runtime_error("Error: Unable to write to file!");
+        }
+        cout << "Data saved successfully to " << output_file << "." << endl;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const DataFrame& df);
+
+    /**
+     * @brief Filters the DataFrame using a mask, such as the result of a Column comparison.
+     * 
+     * @param mask Bitmap with a bit set for each row to include
+     * @return A view of the selected rows that shares this DataFrame's columns
+     * @throws std::out_of_range If the mask size doesn't match the number of data rows
+     * @note No rows are copied; assign the view to a DataFrame to materialize it
+     */
+    DataFrameView operator[](const Bitmap& mask) const;
+
+    /**
+     * @brief Filters the DataFrame using a boolean mask.
+     * 
+     * @param mask Vector of boolean values indicating which rows to include
+     * @return A view of the selected rows that shares this DataFrame's columns
+     * @throws std::out_of_range If the mask size doesn't match the number of data rows
+     */
+    DataFrameView operator[](const vector<bool> & mask) const;
+
+    /**
+     * @brief Accesses a single column by name.
+     * 
+     * @param key The name of the column to access
+     * @return Reference to the Column object
+     * @throws std::out_of_range If the column name is not found
+     */
+    Column& operator[](const string& key) {
+        auto it = col_index.find(key);
+        if (it != col_index.end()) {
+            return col_data[it->second];
+        }
+        throw std::out_of_range("Column not found!");
+    }
+
+    /**
+     * @brief Accesses a single column by name with its element type fixed at compile time.
+     *
+     * @tparam T int64_t for an "int", double for a "float" or string_view for a "string" column
+     * @param key The name of the column to access
+     * @return A TypedColumn sharing the column's buffers, e.g.
+     *         `df.column<double>("Salary").map([](double x) { return x * 1.1; })`
+     * @throws std::out_of_range If the column name is not found
+     * @throws invalid_argument If T does not match the column dtype
+     */
+    template <typename T>
+    TypedColumn<T> column(const string& key) const {
+        const Column* col = find_column(key);
+        if (!col) {
+            throw std::out_of_range("Column not found: " + key);
+        }
+        return col->as<T>();
+    }
+
+    /**
+     * @brief Groups the rows by the values of one or more columns.
+     *
+     * @param keys Names of the key columns
+     * @return A GroupBy object; call agg() on it to aggregate, e.g.
+     *         `df.groupby({"City"}).agg({{"Salary", "mean"}, {"Age", "max"}})`
+     * @throws std::out_of_range If a key column is not found
+     */
+    GroupBy groupby(const vector<string>& keys) const;
+
+    /**
+     * @brief Joins this DataFrame with another one on equal values of key columns.
+     *
+     * When there is a single key and both sides are already sorted on it without missing
+     * values, the rows are matched by one sort-merge pass. Otherwise a hash table is built
+     * on the smaller side (see GroupTable) and the other side probes it in parallel over
+     * fixed ranges of rows. Either way the output columns are gathered from the inputs'
+     * typed buffers in one pass each.
+     *
+     * @param right The DataFrame to join with
+     * @param on Names of the key columns, present in both DataFrames
+     * @param how "inner" (matching rows only), "left" (every row of this DataFrame) or
+     *            "outer" (every row of both) (default: "inner")
+     * @param suffixes Appended to the names of non-key columns present on both sides
+     *                 (default: {"_x", "_y"})
+     * @return The key columns, then the other columns of this DataFrame, then those of right
+     * @throws std::out_of_range If a key column is not found
+     * @throws invalid_argument If how is unknown, on is empty or the key dtypes differ
+     * @note Rows follow the order of this DataFrame, with the matches of each row in the
+     *       order of right; rows only present in right come last. Missing (or NaN) keys
+     *       never match, and columns without a match are NA.
+     */
+    DataFrame merge(const DataFrame& right, const vector<string>& on, const string& how = "inner",
+                    const pair<string, string>& suffixes = {"_x", "_y"}) const;
+
+    /**
+     * @brief Sorts the rows by the values of one or more columns.
+     *
+     * @param keys Names of the key columns, most significant first
+     * @param ascending One direction per key, or a single one for all keys (default: {true})
+     * @return A SortedView; nothing is sorted until its rows are used, and
+     *         `df.sort_values({"Age"}).head(10)` only selects the first 10 rows.
+     *         Assign it to a DataFrame to reorder every column.
+     * @throws std::out_of_range If a key column is not found
+     * @throws invalid_argument If keys is empty or ascending has the wrong size
+     * @note The sort is stable, and missing (or NaN) values come last in either direction
+     */
+    SortedView sort_values(const vector<string>& keys, const vector<bool>& ascending = {true}) const;
+
+    /**
+     * @brief Displays specific columns of the DataFrame.
+     * 
+     * @param keys Vector of column names to display
+     * @return A dummy Column object (for interface compatibility)
+     * @note This method prints the specified columns and returns a dummy Column
+     */
+    Column operator[](const vector<string>& keys) {
+        print(0, 0, keys);
+
+        Column dummy;
+        return dummy;
+    }
+
+private:
+    friend class DataFrameView;
+    friend class GroupBy;
+    friend class SortedView;
+    friend class LazyFrame;
+    friend class CsvChunks;
+
+    static constexpr size_t csv_block_rows = 1 << 14; // rows formatted per task by save_to_csv, at most
+    static constexpr size_t csv_block_bytes = 1 << 20; // estimated text per task, lowering the rows of wide frames
+    static constexpr size_t csv_round_bytes = 1 << 26; // estimated text buffered before it is written
+
+    /**
+     * @brief Rebuilds the name index from col_data.
+     */
+    void index_columns() {
+        col_index.clear();
+        col_index.reserve(col_data.size());
+        for (size_t pos = 0; pos < col_data.size(); pos++) {
+            col_index[col_data[pos].name] = pos;
+        }
+    }
+
+    /**
+     * @brief Looks up a column by name.
+     *
+     * @return The column, or nullptr if there is none with that name
+     */
+    const Column* find_column(const string& key) const {
+        auto it = col_index.find(key);
+        return it == col_index.end() ? nullptr : &col_data[it->second];
+    }
+
+    /**
+     * @brief Reads and checks the header, column entries and names of a binary file.
+     *
+     * @throws runtime_error If they are not those of a valid binary DataFrame
+     */
+    static BinaryHeader read_binary_directory(const MappedFile& file, vector<BinaryColumnEntry>& entries, vector<string>& names) {
+        const char* base = file.data();
+        size_t file_size = file.size();
+        auto invalid = []() {
+            return runtime_error("Error: Invalid binary file!");
+        };
+        auto in_bounds = [&](uint64_t offset, uint64_t length) {
+            return offset <= file_size && length <= file_size - offset;
+        };
+
+        BinaryHeader head;
+        if (file_size < sizeof(head)) {
+            throw invalid();
+        }
+        memcpy(&head, base, sizeof(head));
+        if (memcmp(head.magic, binary_magic, sizeof(binary_magic)) != 0
+            || head.byte_order != binary_byte_order || head.version != binary_version
+            || head.num_cols > file_size / sizeof(BinaryColumnEntry)
+            || !in_bounds(sizeof(head), head.num_cols * sizeof(BinaryColumnEntry))) {
+            throw invalid();
+        }
+
+        entries.resize(head.num_cols);
+        if (!entries.empty()) {
+            memcpy(entries.data(), base + sizeof(head), entries.size() * sizeof(BinaryColumnEntry));
+        }
+        names.clear();
+        for (const BinaryColumnEntry& entry : entries) {
+            if (!in_bounds(entry.name_offset, entry.name_length)) {
+                throw invalid();
+            }
+            names.emplace_back(base + entry.name_offset, entry.name_length);
+        }
+        return head;
+    }
+
+    /**
+     * @brief Reads a binary file like read_binary(), keeping only the rows matching filter (if set).
+     *
+     * The filter's columns are read first; the other columns are then copied only at the
+     * matching rows, straight from the mapped file.
+     */
+    static DataFrame read_binary_where(const string& path, const vector<string>& usecols, const Expr* filter) {
+        LP_PROFILE_SCOPE("read_binary");
+        MappedFile file(path);
+        const char* base = file.data();
+        size_t file_size = file.size();
+        auto invalid = []() {
+            return runtime_error("Error: Invalid binary file!");
+        };
+        auto in_bounds = [&](uint64_t offset, uint64_t length) {
+            return offset <= file_size && length <= file_size - offset;
+        };
+
+        vector<BinaryColumnEntry> entries;
+        vector<string> names;
+        BinaryHeader head = read_binary_directory(file, entries, names);
+
+        vector<bool> wanted(entries.size(), usecols.empty());
+        for (const string& col_name : usecols) {
+            auto it = find(names.begin(), names.end(), col_name);
+            if (it == names.end()) {
+                throw std::out_of_range("Column not found: " + col_name);
+            }
+            wanted[it - names.begin()] = true;
+        }
+
+        size_t n = head.num_rows;
+        // validates column jdx and copies it (only the given rows, when rows is set)
+        auto load = [&](size_t jdx, const vector<size_t>* rows) {
+            const BinaryColumnEntry& entry = entries[jdx];
+            if (entry.dtype > 2 || n > file_size * 8
+                || !in_bounds(entry.validity_offset, (n + 63) / 64 * sizeof(uint64_t))
+                || !in_bounds(entry.data_offset, entry.data_length)) {
+                throw invalid();
+            }
+
+            Column col;
+            col.name = names[jdx];
+            col.dtype = entry.dtype == 0 ? "int" : entry.dtype == 1 ? "float" : "string";
+            const uint64_t* valid_words = reinterpret_cast<const uint64_t*>(base + entry.validity_offset);
+            const uint64_t* offsets = nullptr;
+            if (entry.dtype == 2) {
+                if (!in_bounds(entry.offsets_offset, (n + 1) * sizeof(uint64_t))) {
+                    throw invalid();
+                }
+                offsets = reinterpret_cast<const uint64_t*>(base + entry.offsets_offset);
+                for (size_t idx = 0; idx < n; idx++) {
+                    if (offsets[idx] > offsets[idx + 1]) {
+                        throw invalid();
+                    }
+                }
+                if (offsets[0] != 0 || offsets[n] != entry.data_length) {
+                    throw invalid();
+                }
+            } else if (entry.data_length != n * 8) {
+                throw invalid();
+            }
+            col.assign_buffers(base + entry.data_offset, n, valid_words, offsets, rows);
+            if (entry.dtype == 2) {
+                col.encode(col.size() / CsvReader::dict_ratio);
+            } else if (!rows && entry.zones_offset != 0) {
+                // (zones_offset is 0 in files written before zone maps; comparisons then build them)
+                if (!in_bounds(entry.zones_offset, binary_zones_bytes(n))) {
+                    throw invalid();
+                }
+                const char* stored = base + entry.zones_offset;
+                uint64_t meta[2];
+                memcpy(meta, stored, sizeof(meta));
+                auto restore = [&](auto zones) {
+                    size_t blocks = (binary_zones_bytes(n) / 8 - 2) / 2;
+                    zones.sorted = meta[1] & 1;
+                    zones.complete = (meta[1] >> 1) & 1;
+                    zones.min.resize(blocks);
+                    zones.max.resize(blocks);
+                    memcpy(zones.min.data(), stored + sizeof(meta), blocks * 8);
+                    memcpy(zones.max.data(), stored + sizeof(meta) + blocks * 8, blocks * 8);
+                    col.assign_zone_map(std::move(zones));
+                };
+                // a map with another block size is left to be rebuilt
+                if (meta[0] == ZoneMap<int64_t>::block_rows) {
+                    if (entry.dtype == 0) {
+                        restore(ZoneMap<int64_t>());
+                    } else {
+                        restore(ZoneMap<double>());
+                    }
+                }
+            }
+            return col;
+        };
+
+        // the filter's columns are read first, every other column only at the matching rows
+        vector<Column> filter_cols;
+        vector<size_t> rows;
+        auto filter_col = [&](const string& col_name) {
+            return find_if(filter_cols.begin(), filter_cols.end(), [&](const Column& col) {
+                return col.name == col_name;
+            });
+        };
+        if (filter) {
+            for (const string& col_name : filter->columns()) {
+                auto it = find(names.begin(), names.end(), col_name);
+                if (it == names.end()) {
+                    throw std::out_of_range("Column not found: " + col_name);
+                }
+                filter_cols.push_back(load(it - names.begin(), nullptr));
+            }
+            rows = filter->evaluate([&](const string& col_name) -> const Column& {
+                return *filter_col(col_name);
+            }).indices();
+        }
+
+        DataFrame df;
+        df.file_dir = path;
+        for (size_t jdx = 0; jdx < entries.size(); jdx++) {
+            if (!wanted[jdx]) {
+                continue;
+            }
+            auto it = filter_col(names[jdx]);
+            Column col = it != filter_cols.end() ? it->take(rows) : load(jdx, filter ? &rows : nullptr);
+            df.columns.push_back(col.name);
+            df.col_data.push_back(std::move(col));
+        }
+        df.index_columns();
+        LP_PROFILE_ROWS(df.num_rows(), file_size);
+        LP_PROFILE_MEMORY(df.memory_bytes());
+        return df;
+    }
+
+    /**
+     * @brief Compares row_a of a with row_b of b, two key columns of the same dtype.
+     */
+    static int compare_rows(const Column& a, size_t row_a, const Column& b, size_t row_b);
+
+    /**
+     * @brief Whether a key column has no missing values and is in non-decreasing order.
+     */
+    static bool key_sorted(const Column& key);
+
+    /**
+     * @brief Matches the rows of two sorted key columns; see merge().
+     */
+    static void merge_join(const Column& left_key, const Column& right_key, bool keep_left, bool keep_right,
+                           vector<size_t>& left_rows, vector<size_t>& right_rows, vector<size_t>& right_only);
+
+    /**
+     * @brief Matches rows on any number of key columns with a hash table; see merge().
+     */
+    static void hash_join(const vector<const Column*>& left_keys, const vector<const Column*>& right_keys,
+                          bool keep_left, bool keep_right,
+                          vector<size_t>& left_rows, vector<size_t>& right_rows, vector<size_t>& right_only);
+
+    /**
+     * @brief Prints the given rows (all rows when selection is null); see print().
+     */
+    void print_rows(int rows_cnt, int is_tail, vector<string> cols, const vector<size_t>* selection) const {
+        if (cols.size() == 0) {
+            cols = columns;
+        }
+
+        vector<const Column*> print_cols;
+        for(const string& col : cols) {
+            const Column* found = find_column(col);
+            if (!found) {
+                throw std::out_of_range("Column not found!");
+            }
+            print_cols.push_back(found);
+        }
+
+        size_t total_rows = selection ? selection->size() : num_rows();
+        size_t cnt = total_rows;
+        if (rows_cnt > 0) {
+            cnt = std::min(total_rows, static_cast<size_t>(rows_cnt));
+        }
+        size_t first = is_tail ? total_rows - cnt : 0;
+
+        cout << std::left;
+        for(const Column* col : print_cols) {
+            cout << setw(20) << col->name;
+        }
+        cout << endl;
+
+        for(size_t idx = first; idx < first + cnt; idx++) {
+            size_t row = selection ? (*selection)[idx] : idx;
+            for(const Column* col : print_cols) {
+                cout << setw(20) << col->at(row);
+            }
+            cout << endl;
+        }
+        cout << "\nPrinted: " << cnt << " rows\n";
+    }
+
+    /**
+     * @brief Writes the given rows (all rows when selection is null); see save_to_csv().
+     */
+    void write_csv(
+        const string& output_file,
+        bool index,
+        const string& sep,
+        bool header,
+        const string& na_rep,
+        const vector <string>& selected_columns,
+        const vector<size_t>* selection,
+        size_t num_threads,
+        bool append
+    ) const {
+        LP_PROFILE_SCOPE("save_to_csv");
+        std::filesystem::path file_path(output_file);
+ 
+        // Create directories if they don't exist
+        if (!file_path.parent_path().empty()) {
+           std::filesystem::create_directories(file_path.parent_path());
+        }
+        std::error_code ec;
+        size_t first_index = 0;
+        if (append && std::filesystem::file_size(file_path, ec) > 0 && !ec) {
+           header = false; // the file already starts with one
+           if (index) {
+              first_index = next_index(output_file, sep);
+           }
+        }
+        ofstream file(output_file, append ? ios::binary | ios::app : ios::binary);
+ 
+        if (!file) {
+           throw runtime_error("Error: Unable to open file for writing!");
+        }
+ 
+        // Determine which columns to save, resolving each name once
+        const vector < string > & columns_to_save = selected_columns.empty() ? columns : selected_columns;
+        vector <const Column*> save_cols;
+        for (const string & col_name: columns_to_save) {
+           // Validate selected columns
+           const Column* found = find_column(col_name);
+           if (!found) {
+              throw std::out_of_range("Column not found: " + col_name);
+           }
+           save_cols.push_back(found);
+        }
+
+        // fields containing the separator, a quote or a line break are quoted so the file reads back
+        auto append_field = [&](string& out, string_view field) {
+           bool quote = field.find_first_of("\"\r\n") != string_view::npos
+                        || (!sep.empty() && field.find(sep) != string_view::npos);
+           if (!quote) {
+              out.append(field);
+              return;
+           }
+           out.push_back('"');
+           for (char c : field) {
+              if (c == '"') {
+                 out.push_back('"');
+              }
+              out.push_back(c);
+           }
+           out.push_back('"');
+        };
+ 
+        // handle header option
+        string buffer;
+        if (header) {
+           // index option
+           if (index) {
+              buffer += "index";
+              buffer += sep;
+           }
+           for (size_t i = 0; i < columns_to_save.size(); ++i) {
+              append_field(buffer, columns_to_save[i]);
+              if (i < columns_to_save.size() - 1) {
+                 buffer += sep;
+              }
+           }
+           buffer += '\n';
+           file.write(buffer.data(), buffer.size());
+        }
+ 
+        // Determine the number of rows
+        size_t num_rows = 0;
+        if (selection) {
+           num_rows = selection->size();
+        } else if (!save_cols.empty()) {
+           num_rows = save_cols[0]->size();
+         }
+
+        // Rows are formatted in blocks on several threads, then written in order;
+        // one round of blocks is buffered at a time to bound memory. Blocks and rounds
+        // are sized from an estimate of 8 bytes per field, so wide frames use fewer rows
+        if (num_threads == 0) {
+           num_threads = ThreadPool::concurrency();
+        }
+        LP_PROFILE_ROWS(num_rows, 0);
+        size_t row_bytes = (save_cols.size() + 1) * 8;
+        size_t block_rows = std::clamp<size_t>(csv_block_bytes / row_bytes, 1, csv_block_rows);
+        size_t num_blocks = (num_rows + block_rows - 1) / block_rows;
+        size_t round_blocks = std::clamp<size_t>(csv_round_bytes / (block_rows * row_bytes), 1,
+                                                 std::max<size_t>(1, num_threads) * 2);
+        vector<string> blocks(std::min(num_blocks, round_blocks));
+        // the dtype of each column is resolved once, not per field
+        vector<const int64_t*> int_values(save_cols.size(), nullptr);
+        vector<const double*> float_values(save_cols.size(), nullptr);
+        for (size_t j = 0; j < save_cols.size(); ++j) {
+           if (save_cols[j]->dtype == "int") {
+              int_values[j] = save_cols[j]->int_values().data();
+           } else if (save_cols[j]->dtype == "float") {
+              float_values[j] = save_cols[j]->float_values().data();
+           }
+        }
+
+        for (size_t first_block = 0; first_block < num_blocks; first_block += round_blocks) {
+           size_t cnt = std::min(round_blocks, num_blocks - first_block);
+           parallel_for(cnt, num_threads, [&](size_t k) {
+              string& out = blocks[k];
+              out.clear();
+              size_t begin = (first_block + k) * block_rows;
+              size_t end = std::min(num_rows, begin + block_rows);
+              out.reserve((end - begin) * row_bytes);
+              char num_buf[32];
+
+              for (size_t idx = begin; idx < end; ++idx) {
+                 if (index) {
+                    auto res = to_chars(num_buf, num_buf + sizeof(num_buf), first_index + idx);
+                    out.append(num_buf, res.ptr);
+                    out += sep;
+                 }
+
+                 size_t row = selection ? (*selection)[idx] : idx;
+                 for (size_t j = 0; j < save_cols.size(); ++j) {
+                    const Column & col = *save_cols[j];
+
+                    // Replace missing values with `na_rep` string
+                    if (col.is_na(row)) {
+                       out += na_rep;
+                    } else if (int_values[j]) {
+                       auto res = to_chars(num_buf, num_buf + sizeof(num_buf), int_values[j][row]);
+                       out.append(num_buf, res.ptr);
+                    } else if (float_values[j]) {
+                       auto res = to_chars(num_buf, num_buf + sizeof(num_buf), float_values[j][row]);
+                       out.append(num_buf, res.ptr);
+                    } else {
+                       append_field(out, col.str_at(row));
+                    }
+
+                    if (j < save_cols.size() - 1) {
+                       out += sep;
+                    }
+                 }
+                 out += '\n';
+              }
+           });
+           for (size_t k = 0; k < cnt; k++) {
+              file.write(blocks[k].data(), blocks[k].size());
+              LP_PROFILE_ROWS(0, blocks[k].size());
+           }
+        }
+ 
+        file.close();
+        if (!file) {
+           throw runtime_error("Error: Unable to write to file!");
+        }
+        cout << "Data saved successfully to " << output_file << " with separator '" << sep << "'." << endl;
+     }
+
+    /**
+     * @brief Returns the index following the last one in a CSV file written with index=true,
+     *        so appended rows continue its numbering; 0 if the file has no index column.
+     *
+     * Only the header row and the last 64 KB of the file are read.
+     */
+    static size_t next_index(const string& path, const string& sep) {
+        ifstream in(path, ios::binary);
+        string line;
+        getline(in, line);
+        if (line.compare(0, 5 + sep.size(), "index" + sep) != 0) {
+            return 0;
+        }
+        constexpr size_t tail_bytes = 1 << 16;
+        in.clear();
+        in.seekg(0, ios::end);
+        size_t size = static_cast<size_t>(in.tellg());
+        size_t start = size > tail_bytes ? size - tail_bytes : 0;
+        string tail(size - start, '\0');
+        in.seekg(start);
+        in.read(&tail[0], tail.size());
+
+        // the last line that starts with an index value and the separator
+        for (size_t pos = tail.size(); pos > 0; pos--) {
+            if (tail[pos - 1] != '\n') {
+                continue;
+            }
+            size_t value = 0;
+            const char* first = tail.data() + pos;
+            auto res = from_chars(first, tail.data() + tail.size(), value);
+            if (res.ec == errc() && res.ptr != first && tail.compare(res.ptr - tail.data(), sep.size(), sep) == 0) {
+                return value + 1;
+            }
+        }
+        return 0;
+    }
+};
+
+inline DataFrame Column::value_counts() const {
+    vector<size_t> first_rows;
+    vector<size_t> counts = count_distinct(&first_rows);
+    vector<size_t> order(counts.size());
+    for (size_t id = 0; id < order.size(); id++) {
+        order[id] = id;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return counts[a] > counts[b];
+    });
+
+    vector<size_t> rows(order.size());
+    Column count;
+    count.dtype = "int";
+    for (size_t k = 0; k < order.size(); k++) {
+        rows[k] = first_rows[order[k]];
+        count.append(counts[order[k]]);
+    }
+    DataFrame result;
+    result.assign(name, take(rows));
+    result.assign(name == "count" ? "count_count" : "count", std::move(count));
+    return result;
+}
+
+/**
+ * @brief Reads a CSV file as a sequence of DataFrames of at most chunk_rows rows each.
+ *
+ * Returned by DataFrame::read_csv_chunks(). Only one chunk is held at a time and the
+ * pages of the file already read are released, so memory use depends on the chunk size,
+ * not the file size. Reductions carry over between chunks by merging ColumnStats, and
+ * filtered chunks can be appended to one output file:
+ *
+ *     CsvChunks chunks = DataFrame::read_csv_chunks("big.csv", 1 << 20);
+ *     DataFrame chunk;
+ *     ColumnStats price;
+ *     while (chunks.next(chunk)) {
+ *         price.merge(chunk["price"].stats());
+ *         chunk[chunk["price"] > 100].save_to_csv("expensive.csv", false, ",", true, "", {}, 0, true);
+ *     }
+ *
+ * @note Each chunk infers its own dtypes, starting from those of the chunks before it, so a
+ *       column may widen (e.g. from int to float) in a later chunk but never narrows. Give
+ *       CsvOptions::dtypes to fix the schema up front.
+ */
+class CsvChunks {
+public:
+    /**
+     * @brief Reads the next chunk.
+     *
+     * @param chunk Replaced with the chunk's rows
+     * @return False, leaving chunk untouched, once every row has been read
+     * @throws runtime_error If a row has more fields than the header, or does not match a dtype
+     *         given in CsvOptions::dtypes
+     */
+    bool next(DataFrame& chunk) {
+        vector<string> columns;
+        vector<Column> cols;
+        if (!reader->read_next(chunk_rows, columns, cols)) {
+            return false;
+        }
+        chunk.file_dir = path;
+        chunk.columns = std::move(columns);
+        chunk.col_data = std::move(cols);
+        chunk.index_columns();
+        return true;
+    }
+
+private:
+    friend class DataFrame;
+
+    string path;
+    size_t chunk_rows;
+    unique_ptr<CsvReader> reader; // keeps its position in the file between calls
+
+    CsvChunks(const string& path, size_t chunk_rows, const CsvOptions& options)
+    : path(path), chunk_rows(chunk_rows), reader(make_unique<CsvReader>(path, options)) {}
+};
+
+inline CsvChunks DataFrame::read_csv_chunks(const string& path, size_t chunk_rows, const CsvOptions& options) {
+    if (chunk_rows == 0) {
+        throw invalid_argument("Invalid argument: DataFrame::read_csv_chunks() expects `chunk_rows` to be positive");
+    }
+    return CsvChunks(path, chunk_rows, options);
+}
+
+/**
+ * @brief A lightweight selection of rows from a DataFrame.
+ *
+ * Returned by DataFrame::operator[](mask). The view shares the parent's column
+ * buffers and only stores the indices of the selected rows, so filtering costs
+ * O(selected rows) memory. Rows are copied only when the view is materialized,
+ * either by converting it to a DataFrame or by taking one of its columns.
+ *
+ * @note Like std::string_view, a view refers to its parent: it must not outlive the
+ *       DataFrame it was created from, nor be used after that DataFrame is modified.
+ */
+class DataFrameView {
+public:
+    /**
+     * @brief Creates a view of the given rows of a DataFrame.
+     *
+     * @param parent The DataFrame the view refers to
+     * @param rows Indices of the selected rows, in increasing order
+     */
+    DataFrameView(const DataFrame& parent, vector<size_t> rows)
+    : parent(&parent), rows(std::move(rows)) {}
+
+    /**
+     * @brief Returns the number of selected rows.
+     */
+    size_t num_rows() const {
+        return rows.size();
+    }
+
+    /**
+     * @brief Returns the indices of the selected rows in the parent DataFrame.
+     */
+    const vector<size_t>& row_indices() const {
+        return rows;
+    }
+
+    /**
+     * @brief Returns the names of the view's columns.
+     */
+    const vector<string>& columns() const {
+        return parent->columns;
+    }
+
+    /**
+     * @brief Narrows the view with another mask.
+     *
+     * @param mask Bitmap over the parent's rows (e.g. `df["Age"] > 30`) or over the view's rows
+     * @return A view of the rows selected by both this view and the mask
+     * @throws std::out_of_range If the mask size matches neither the parent nor the view
+     */
+    DataFrameView operator[](const Bitmap& mask) const {
+        vector<size_t> kept;
+        if (mask.size() == parent->num_rows()) {
+            for (size_t row : rows) {
+                if (mask[row]) {
+                    kept.push_back(row);
+                }
+            }
+        } else if (mask.size() == rows.size()) {
+            for (size_t idx = 0; idx < rows.size(); idx++) {
+                if (mask[idx]) {
+                    kept.push_back(rows[idx]);
+                }
+            }
+        } else {
+            throw std::out_of_range("Mask size does not match data rows!");
+        }
+        return DataFrameView(*parent, std::move(kept));
+    }
+
+    DataFrameView operator[](const vector<bool>& mask) const {
+        return (*this)[Bitmap(mask)];
+    }
+
+    /**
+     * @brief Materializes one column of the view.
+     *
+     * @param key The name of the column
+     * @return A new Column holding the selected rows
+     * @throws std::out_of_range If the column name is not found
+     */
+    Column operator[](const string& key) const {
+        const Column* col = parent->find_column(key);
+        if (!col) {
+            throw std::out_of_range("Column not found!");
+        }
+        return col->take(rows);
+    }
+
+    /**
+     * @brief Copies the selected rows into a new DataFrame.
+     */
+    DataFrame to_frame() const {
+        return DataFrame(*this);
+    }
+
+    /**
+     * @brief Prints the selected rows; see DataFrame::print().
+     */
+    void print(int rows_cnt = 0, int is_tail = 0, vector<string> cols = {}) const {
+        parent->print_rows(rows_cnt, is_tail, cols, &rows);
+    }
+
+    void head(int rows_cnt = 5) const {
+        print(rows_cnt);
+    }
+
+    void tail(int rows_cnt = 5) const {
+        print(rows_cnt, 1);
+    }
+
+    /**
+     * @brief Saves the selected rows to a CSV file without materializing them; see DataFrame::save_to_csv().
+     */
+    void save_to_csv(
+        const string& output_file,
+        bool index = true,
+        const string& sep = ",",
+        bool header = true,
+        const string& na_rep = "",
+        const vector <string>& selected_columns = {},
+        size_t num_threads = 0,
+        bool append = false
+    ) const {
+        parent->write_csv(output_file, index, sep, header, na_rep, selected_columns, &rows, num_threads, append);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const DataFrameView& view);
+
+private:
+    friend class DataFrame;
+
+    const DataFrame* parent;
+    vector<size_t> rows;
+};
+
+inline DataFrame::DataFrame(const DataFrameView& view)
+: file_dir(view.parent->file_dir),
+  columns(view.parent->columns) {
+    LP_PROFILE_SCOPE("filter");
+    LP_PROFILE_ROWS(view.parent->num_rows(), 0);
+    col_data.reserve(view.parent->col_data.size());
+    for (const Column& col : view.parent->col_data) {
+        col_data.push_back(col.take(view.rows));
+    }
+    index_columns();
+    LP_PROFILE_MEMORY(memory_bytes());
+}
+
+inline DataFrameView DataFrame::operator[](const Bitmap& mask) const {
+    if (mask.size() != num_rows()) {
+        throw std::out_of_range("Mask size does not match data rows!");
+    }
+    return DataFrameView(*this, mask.indices());
+}
+
+inline DataFrameView DataFrame::operator[](const vector<bool> & mask) const {
+    return (*this)[Bitmap(mask)];
+}
+
+/**
+ * @brief Rows of a DataFrame grouped by the values of one or more key columns.
+ *
+ * Returned by DataFrame::groupby(). Like DataFrameView it refers to its parent, which
+ * must outlive it and not be modified while it is in use.
+ */
+class GroupBy {
+public:
+    /**
+     * @brief Groups the rows of a DataFrame.
+     *
+     * @param parent The DataFrame to group
+     * @param keys Names of the key columns
+     * @throws std::out_of_range If a key column is not found
+     * @throws invalid_argument If keys is empty
+     */
+    GroupBy(const DataFrame& parent, vector<string> keys)
+    : parent(&parent), keys(std::move(keys)) {
+        if (this->keys.empty()) {
+            throw invalid_argument("Invalid argument: DataFrame::groupby() expects at least one key column");
+        }
+        for (const string& key : this->keys) {
+            const Column* col = parent.find_column(key);
+            if (!col) {
+                throw std::out_of_range("Column not found!");
+            }
+            key_cols.push_back(col);
+        }
+    }
+
+    /**
+     * @brief Aggregates columns within each group.
+     *
+     * Rows are hashed into thread-local open-addressing tables (see GroupTable), one per
+     * fixed range of rows, and each aggregate is accumulated in a tight loop over the typed
+     * column buffer. The partial tables are then merged in row order, so the result does not
+     * depend on the number of threads.
+     *
+     * @param aggs Pairs of (column name, function), where function is "sum", "mean", "min",
+     *             "max" or "count"
+     * @return A DataFrame with the key columns followed by one column per aggregate, named
+     *         `<column>_<function>`, with one row per group sorted by key
+     * @throws std::out_of_range If an aggregated column is not found
+     * @throws invalid_argument If a function is unknown, or sum/mean/min/max is applied to a string column
+     * @note Rows with a missing (or NaN) key are dropped; missing values are skipped when
+     *       aggregating. min/max keep the column's dtype, sum keeps it too and is exact on int
+     *       columns (wrapping around on overflow), mean is a float and count is an int.
+     */
+    DataFrame agg(const vector<pair<string, string>>& aggs) const;
+
+private:
+    // running aggregate of one column within one group; int columns also keep exact
+    // int64 sum/min/max, since a double cannot hold every int64
+    struct Acc {
+        uint64_t count = 0;
+        double sum = 0;
+        double min = numeric_limits<double>::infinity();
+        double max = -numeric_limits<double>::infinity();
+        uint64_t int_sum = 0; // two's complement, so overflow wraps around
+        int64_t int_min = numeric_limits<int64_t>::max();
+        int64_t int_max = numeric_limits<int64_t>::min();
+
+        void add(double x) {
+            count++;
+            sum += x;
+            min = std::min(min, x);
+            max = std::max(max, x);
+        }
+
+        void add(int64_t x) {
+            count++;
+            sum += static_cast<double>(x);
+            int_sum += static_cast<uint64_t>(x);
+            int_min = std::min(int_min, x);
+            int_max = std::max(int_max, x);
+        }
+
+        void merge(const Acc& other) {
+            count += other.count;
+            sum += other.sum;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            int_sum += other.int_sum;
+            int_min = std::min(int_min, other.int_min);
+            int_max = std::max(int_max, other.int_max);
+        }
+    };
+
+    // the groups found in one range of rows
+    struct Partial {
+        GroupTable table;
+        vector<size_t> first_row; // first row of each local group
+        vector<vector<Acc>> accs; // per aggregated column, per local group
+
+        explicit Partial(size_t width) : table(width) {}
+    };
+
+    const DataFrame* parent;
+    vector<string> keys;
+    vector<const Column*> key_cols;
+};
+
+inline GroupBy DataFrame::groupby(const vector<string>& keys) const {
+    return GroupBy(*this, keys);
+}
+
+inline DataFrame GroupBy::agg(const vector<pair<string, string>>& aggs) const {
+    LP_PROFILE_SCOPE("groupby.agg");
+    LP_PROFILE_ROWS(parent->num_rows(), 0);
+    // resolve the aggregated columns, sharing one accumulator per distinct column
+    vector<const Column*> value_cols;
+    vector<size_t> acc_of(aggs.size());
+    for (size_t a = 0; a < aggs.size(); a++) {
+        const auto& [col_name, func] = aggs[a];
+        const Column* col = parent->find_column(col_name);
+        if (!col) {
+            throw std::out_of_range("Column not found!");
+        }
+        if (func != "sum" && func != "mean" && func != "min" && func != "max" && func != "count") {
+            throw invalid_argument("Invalid argument: GroupBy::agg() expects sum, mean, min, max or count, got " + func);
+        }
+        if (func != "count" && col->dtype == "string") {
+            throw invalid_argument("Invalid type: GroupBy::agg() expects `dtype` to be int or float for " + func);
+        }
+        auto it = find(value_cols.begin(), value_cols.end(), col);
+        acc_of[a] = it - value_cols.begin();
+        if (it == value_cols.end()) {
+            value_cols.push_back(col);
+        }
+    }
+
+    // plain string keys get dense ids first, every other key is used as is
+    struct KeySource {
+        const Bitmap* valid;
+        const int64_t* ints = nullptr;
+        const double* floats = nullptr;
+        const uint32_t* ids = nullptr; // dictionary codes or the dense ids
+    };
+    size_t width = key_cols.size();
+    vector<KeySource> sources(width);
+    vector<vector<uint32_t>> str_ids(width);
+    for (size_t c = 0; c < width; c++) {
+        const Column& col = *key_cols[c];
+        sources[c].valid = &col.valid();
+        if (col.dtype == "int") {
+            sources[c].ints = col.int_values().data();
+        } else if (col.dtype == "float") {
+            sources[c].floats = col.float_values().data();
+        } else if (col.is_encoded()) {
+            sources[c].ids = col.codes().data();
+        } else {
+            StringIds ids;
+            str_ids[c].resize(col.size());
+            for (size_t row = 0; row < col.size(); row++) {
+                str_ids[c][row] = ids.find_or_insert(col.str_at(row));
+            }
+            sources[c].ids = str_ids[c].data();
+        }
+    }
+    // writes the key word of column c at row; false if the key is missing
+    auto key_word = [&](size_t c, size_t row, uint64_t& word) {
+        const KeySource& source = sources[c];
+        if (!source.valid->get(row)) {
+            return false;
+        }
+        if (source.ints) {
+            word = static_cast<uint64_t>(source.ints[row]);
+        } else if (source.floats) {
+            double x = source.floats[row];
+            if (x != x) {
+                return false;
+            }
+            x = x == 0 ? 0.0 : x; // -0.0 and 0.0 are the same key
+            memcpy(&word, &x, sizeof(word));
+        } else {
+            word = source.ids[row];
+        }
+        return true;
+    };
+
+    constexpr size_t task_rows = 1 << 20;
+    constexpr uint32_t no_group = numeric_limits<uint32_t>::max();
+    size_t n = parent->num_rows();
+    size_t num_tasks = std::max<size_t>(1, (n + task_rows - 1) / task_rows);
+    vector<Partial> partials(num_tasks, Partial(width));
+
+    parallel_for(num_tasks, n >= parallel_min_rows ? 0 : 1, [&](size_t task) {
+        Partial& part = partials[task];
+        size_t begin = task * task_rows;
+        size_t end = std::min(n, begin + task_rows);
+
+        vector<uint32_t> group_of(end - begin, no_group);
+        vector<uint64_t> key(width);
+        for (size_t row = begin; row < end; row++) {
+            bool present = true;
+            for (size_t c = 0; c < width && present; c++) {
+                present = key_word(c, row, key[c]);
+            }
+            if (!present) {
+                continue;
+            }
+            uint32_t id = part.table.find_or_insert(key.data(), part.table.hash_key(key.data()));
+            if (id == part.first_row.size()) {
+                part.first_row.push_back(row);
+            }
+            group_of[row - begin] = id;
+        }
+
+        part.accs.assign(value_cols.size(), vector<Acc>(part.table.size()));
+        for (size_t v = 0; v < value_cols.size(); v++) {
+            const Column& col = *value_cols[v];
+            vector<Acc>& accs = part.accs[v];
+            const Bitmap& valid = col.valid();
+            if (col.dtype == "int") {
+                const vector<int64_t>& values = col.int_values();
+                for (size_t row = begin; row < end; row++) {
+                    uint32_t id = group_of[row - begin];
+                    if (id != no_group && valid.get(row)) {
+                        accs[id].add(values[row]);
+                    }
+                }
+            } else if (col.dtype == "float") {
+                const vector<double>& values = col.float_values();
+                for (size_t row = begin; row < end; row++) {
+                    uint32_t id = group_of[row - begin];
+                    if (id != no_group && valid.get(row) && values[row] == values[row]) {
+                        accs[id].add(values[row]);
+                    }
+                }
+            } else {
+                // only count is allowed on strings
+                for (size_t row = begin; row < end; row++) {
+                    uint32_t id = group_of[row - begin];
+                    if (id != no_group && valid.get(row)) {
+                        accs[id].count++;
+                    }
+                }
+            }
+        }
+    });
+
+    // merge the partial tables in row order
+    GroupTable groups(width);
+    vector<size_t> first_row;
+    vector<vector<Acc>> accs(value_cols.size());
+    for (Partial& part : partials) {
+        for (size_t local = 0; local < part.table.size(); local++) {
+            uint32_t id = groups.find_or_insert(part.table.key(local), part.table.hash(local));
+            if (id == first_row.size()) {
+                first_row.push_back(part.first_row[local]);
+                for (vector<Acc>& col_accs : accs) {
+                    col_accs.emplace_back();
+                }
+            }
+            for (size_t v = 0; v < value_cols.size(); v++) {
+                accs[v][id].merge(part.accs[v][local]);
+            }
+        }
+    }
+
+    // sort the groups by key
+    vector<size_t> order(first_row.size());
+    for (size_t g = 0; g < order.size(); g++) {
+        order[g] = g;
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        size_t ra = first_row[a];
+        size_t rb = first_row[b];
+        for (size_t c = 0; c < width; c++) {
+            const KeySource& source = sources[c];
+            if (source.ints) {
+                if (source.ints[ra] != source.ints[rb]) {
+                    return source.ints[ra] < source.ints[rb];
+                }
+            } else if (source.floats) {
+                if (source.floats[ra] != source.floats[rb]) {
+                    return source.floats[ra] < source.floats[rb];
+                }
+            } else if (source.ids[ra] != source.ids[rb]) {
+                return key_cols[c]->str_at(ra) < key_cols[c]->str_at(rb);
+            }
+        }
+        return false;
+    });
+
+    DataFrame result;
+    vector<size_t> sorted_rows;
+    for (size_t g : order) {
+        sorted_rows.push_back(first_row[g]);
+    }
+    for (const Column* col : key_cols) {
+        result.col_data.push_back(col->take(sorted_rows));
+    }
+    for (size_t a = 0; a < aggs.size(); a++) {
+        const auto& [col_name, func] = aggs[a];
+        const vector<Acc>& col_accs = accs[acc_of[a]];
+        Column out;
+        out.name = col_name + "_" + func;
+        bool keep_dtype = func == "min" || func == "max" || func == "sum";
+        bool exact = value_cols[acc_of[a]]->dtype == "int" && keep_dtype;
+        out.dtype = func == "count" ? "int" : keep_dtype ? value_cols[acc_of[a]]->dtype : "float";
+        out.reserve(order.size());
+        for (size_t g : order) {
+            const Acc& acc = col_accs[g];
+            if (func == "count") {
+                out.append(static_cast<int64_t>(acc.count));
+            } else if (exact && func == "sum") {
+                out.append(static_cast<int64_t>(acc.int_sum));
+            } else if (exact && acc.count > 0) {
+                out.append(func == "min" ? acc.int_min : acc.int_max);
+            } else if (func == "sum") {
+                out.append(acc.sum);
+            } else if (acc.count == 0) {
+                out.append_na();
+            } else {
+                out.append(func == "mean" ? acc.sum / acc.count : func == "min" ? acc.min : acc.max);
+            }
+        }
+        result.col_data.push_back(std::move(out));
+    }
+    for (const Column& col : result.col_data) {
+        result.columns.push_back(col.name);
+    }
+    result.index_columns();
+    return result;
+}
+
+inline bool DataFrame::key_sorted(const Column& key) {
+    // both answers are cached in the column, so joining on it again does not rescan it
+    return key.count() == key.size() && key.is_sorted();
+}
+
+inline int DataFrame::compare_rows(const Column& a, size_t row_a, const Column& b, size_t row_b) {
+    if (a.dtype == "int") {
+        int64_t x = a.int_values()[row_a];
+        int64_t y = b.int_values()[row_b];
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+    if (a.dtype == "float") {
+        double x = a.float_values()[row_a];
+        double y = b.float_values()[row_b];
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+    return a.str_at(row_a).compare(b.str_at(row_b));
+}
+
+inline void DataFrame::merge_join(const Column& left_key, const Column& right_key, bool keep_left, bool keep_right,
+                                  vector<size_t>& left_rows, vector<size_t>& right_rows, vector<size_t>& right_only) {
+    size_t n_left = left_key.size();
+    size_t n_right = right_key.size();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < n_left || j < n_right) {
+        int cmp = i == n_left ? 1 : j == n_right ? -1 : compare_rows(left_key, i, right_key, j);
+        if (cmp < 0) {
+            if (keep_left) {
+                left_rows.push_back(i);
+                right_rows.push_back(Column::npos);
+            }
+            i++;
+        } else if (cmp > 0) {
+            if (keep_right) {
+                right_only.push_back(j);
+            }
+            j++;
+        } else {
+            // every pair of rows in the two runs of equal keys
+            size_t i_end = i + 1;
+            while (i_end < n_left && compare_rows(left_key, i_end, left_key, i) == 0) {
+                i_end++;
+            }
+            size_t j_end = j + 1;
+            while (j_end < n_right && compare_rows(right_key, j_end, right_key, j) == 0) {
+                j_end++;
+            }
+            for (size_t a = i; a < i_end; a++) {
+                for (size_t b = j; b < j_end; b++) {
+                    left_rows.push_back(a);
+                    right_rows.push_back(b);
+                }
+            }
+            i = i_end;
+            j = j_end;
+        }
+    }
+}
+
+inline void DataFrame::hash_join(const vector<const Column*>& left_keys, const vector<const Column*>& right_keys,
+                                 bool keep_left, bool keep_right,
+                                 vector<size_t>& left_rows, vector<size_t>& right_rows, vector<size_t>& right_only) {
+    size_t width = left_keys.size();
+    size_t n_left = left_keys[0]->size();
+    size_t n_right = right_keys[0]->size();
+
+    // one 64-bit word per key and row, comparable across the two frames; rows with a
+    // missing key get present = 0 and never match
+    vector<vector<uint64_t>> left_words(width, vector<uint64_t>(n_left));
+    vector<vector<uint64_t>> right_words(width, vector<uint64_t>(n_right));
+    vector<uint8_t> left_present(n_left, 1);
+    vector<uint8_t> right_present(n_right, 1);
+    for (size_t c = 0; c < width; c++) {
+        StringIds ids;
+        auto encode_side = [&](const Column& col, vector<uint64_t>& words, vector<uint8_t>& present) {
+            const Bitmap& valid = col.valid();
+            if (col.dtype == "int") {
+                const vector<int64_t>& values = col.int_values();
+                for (size_t row = 0; row < col.size(); row++) {
+                    words[row] = static_cast<uint64_t>(values[row]);
+                }
+            } else if (col.dtype == "float") {
+                const vector<double>& values = col.float_values();
+                for (size_t row = 0; row < col.size(); row++) {
+                    double x = values[row] == 0 ? 0.0 : values[row]; // -0.0 and 0.0 are the same key
+                    present[row] &= x == x;
+                    memcpy(&words[row], &x, sizeof(x));
+                }
+            } else if (col.is_encoded()) {
+                // map each dictionary entry once, then translate the codes
+                vector<uint32_t> code_ids;
+                for (const string& value : col.categories()) {
+                    code_ids.push_back(ids.find_or_insert(value));
+                }
+                const vector<uint32_t>& codes = col.codes();
+                for (size_t row = 0; row < col.size(); row++) {
+                    words[row] = valid.get(row) ? code_ids[codes[row]] : 0;
+                }
+            } else {
+                for (size_t row = 0; row < col.size(); row++) {
+                    words[row] = valid.get(row) ? ids.find_or_insert(col.str_at(row)) : 0;
+                }
+            }
+            for (size_t row = 0; row < col.size(); row++) {
+                present[row] &= valid.get(row);
+            }
+        };
+        encode_side(*left_keys[c], left_words[c], left_present);
+        encode_side(*right_keys[c], right_words[c], right_present);
+    }
+
+    // build on the smaller side, probe with the other one
+    bool build_left = n_left < n_right;
+    size_t n_build = build_left ? n_left : n_right;
+    size_t n_probe = build_left ? n_right : n_left;
+    const auto& build_words = build_left ? left_words : right_words;
+    const auto& probe_words = build_left ? right_words : left_words;
+    const auto& build_present = build_left ? left_present : right_present;
+    const auto& probe_present = build_left ? right_present : left_present;
+
+    GroupTable table(width);
+    vector<size_t> head; // first build row of each key
+    vector<size_t> next(n_build, Column::npos); // next build row with the same key
+    vector<uint64_t> key(width);
+    for (size_t row = n_build; row-- > 0; ) {
+        if (!build_present[row]) {
+            continue;
+        }
+        for (size_t c = 0; c < width; c++) {
+            key[c] = build_words[c][row];
+        }
+        uint32_t id = table.find_or_insert(key.data(), table.hash_key(key.data()));
+        if (id == head.size()) {
+            head.push_back(Column::npos);
+        }
+        // inserted back to front, so each chain lists its rows in increasing order
+        next[row] = head[id];
+        head[id] = row;
+    }
+
+    // probe in fixed ranges of rows, each collecting its own (probe, build) pairs
+    bool keep_probe = build_left ? keep_right : keep_left;
+    constexpr size_t task_rows = 1 << 16;
+    size_t num_tasks = (n_probe + task_rows - 1) / task_rows;
+    vector<vector<pair<size_t, size_t>>> pairs(num_tasks);
+    parallel_for(num_tasks, n_probe >= parallel_min_rows ? 0 : 1, [&](size_t task) {
+        vector<uint64_t> probe_key(width);
+        size_t end = std::min(n_probe, (task + 1) * task_rows);
+        for (size_t row = task * task_rows; row < end; row++) {
+            uint32_t id = GroupTable::none;
+            if (probe_present[row]) {
+                for (size_t c = 0; c < width; c++) {
+                    probe_key[c] = probe_words[c][row];
+                }
+                id = table.find(probe_key.data(), table.hash_key(probe_key.data()));
+            }
+            if (id == GroupTable::none) {
+                if (keep_probe) {
+                    pairs[task].emplace_back(row, Column::npos);
+                }
+                continue;
+            }
+            for (size_t b = head[id]; b != Column::npos; b = next[b]) {
+                pairs[task].emplace_back(row, b);
+            }
+        }
+    });
+
+    if (!build_left) {
+        // the probe side is the left frame, so the pairs are already in left order
+        vector<uint8_t> matched(keep_right ? n_right : 0, 0);
+        for (const auto& task_pairs : pairs) {
+            for (const auto& [l, r] : task_pairs) {
+                left_rows.push_back(l);
+                right_rows.push_back(r);
+                if (keep_right && r != Column::npos) {
+                    matched[r] = 1;
+                }
+            }
+        }
+        for (size_t r = 0; keep_right && r < n_right; r++) {
+            if (!matched[r]) {
+                right_only.push_back(r);
+            }
+        }
+        return;
+    }
+
+    // the probe side is the right frame: reorder the pairs by left row
+    vector<pair<size_t, size_t>> by_left;
+    vector<uint8_t> matched(n_left, 0);
+    for (const auto& task_pairs : pairs) {
+        for (const auto& [r, l] : task_pairs) {
+            if (l == Column::npos) {
+                right_only.push_back(r);
+            } else {
+                by_left.emplace_back(l, r);
+                matched[l] = 1;
+            }
+        }
+    }
+    for (size_t l = 0; keep_left && l < n_left; l++) {
+        if (!matched[l]) {
+            by_left.emplace_back(l, Column::npos);
+        }
+    }
+    stable_sort(by_left.begin(), by_left.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    for (const auto& [l, r] : by_left) {
+        left_rows.push_back(l);
+        right_rows.push_back(r);
+    }
+}
+
+inline DataFrame DataFrame::merge(const DataFrame& right, const vector<string>& on, const string& how,
+                                  const pair<string, string>& suffixes) const {
+    LP_PROFILE_SCOPE("merge");
+    LP_PROFILE_ROWS(num_rows() + right.num_rows(), 0);
+    if (how != "inner" && how != "left" && how != "outer") {
+        throw invalid_argument("Invalid argument: DataFrame::merge() expects `how` to be inner, left or outer");
+    }
+    if (on.empty()) {
+        throw invalid_argument("Invalid argument: DataFrame::merge() expects at least one key column");
+    }
+    vector<const Column*> left_keys;
+    vector<const Column*> right_keys;
+    for (const string& key : on) {
+        const Column* l = find_column(key);
+        const Column* r = right.find_column(key);
+        if (!l || !r) {
+            throw std::out_of_range("Column not found!");
+        }
+        if (l->dtype != r->dtype) {
+            throw invalid_argument("Invalid type: DataFrame::merge() expects key columns to have the same dtype");
+        }
+        left_keys.push_back(l);
+        right_keys.push_back(r);
+    }
+
+    bool keep_left = how != "inner";
+    bool keep_right = how == "outer";
+    vector<size_t> left_rows;
+    vector<size_t> right_rows;
+    vector<size_t> right_only; // unmatched right rows, appended after the others for outer joins
+    if (on.size() == 1 && key_sorted(*left_keys[0]) && key_sorted(*right_keys[0])) {
+        merge_join(*left_keys[0], *right_keys[0], keep_left, keep_right, left_rows, right_rows, right_only);
+    } else {
+        hash_join(left_keys, right_keys, keep_left, keep_right, left_rows, right_rows, right_only);
+    }
+
+    // gather the output columns; rows only present on the right come last
+    size_t num_matched = left_rows.size();
+    left_rows.insert(left_rows.end(), right_only.size(), Column::npos);
+    right_rows.insert(right_rows.end(), right_only.begin(), right_only.end());
+
+    DataFrame result;
+    auto is_key = [&](const string& name) {
+        return find(on.begin(), on.end(), name) != on.end();
+    };
+    for (size_t c = 0; c < on.size(); c++) {
+        Column key = left_keys[c]->take(vector<size_t>(left_rows.begin(), left_rows.begin() + num_matched));
+        key.concat(right_keys[c]->take(right_only));
+        result.col_data.push_back(std::move(key));
+    }
+    for (const Column& col : col_data) {
+        if (is_key(col.name)) {
+            continue;
+        }
+        result.col_data.push_back(col.take(left_rows));
+        if (right.find_column(col.name)) {
+            result.col_data.back().name += suffixes.first;
+        }
+    }
+    for (const Column& col : right.col_data) {
+        if (is_key(col.name)) {
+            continue;
+        }
+        result.col_data.push_back(col.take(right_rows));
+        if (find_column(col.name)) {
+            result.col_data.back().name += suffixes.second;
+        }
+    }
+    for (const Column& col : result.col_data) {
+        result.columns.push_back(col.name);
+    }
+    result.index_columns();
+    LP_PROFILE_MEMORY(result.memory_bytes());
+    return result;
+}
+
+/**
+ * @brief Sorts (key, row) pairs by key with an LSD radix sort over bytes, keeping the order of equal keys.
+ *
+ * One pass over the keys builds the histograms of all eight digits; digits on which every
+ * key agrees are skipped, so narrow key ranges need only a few passes.
+ */
+inline void radix_sort(vector<uint64_t>& keys, vector<size_t>& rows) {
+    size_t n = keys.size();
+    vector<array<size_t, 256>> counts(8);
+    for (auto& count : counts) {
+        count.fill(0);
+    }
+    for (uint64_t key : keys) {
+        for (size_t d = 0; d < 8; d++) {
+            counts[d][(key >> (8 * d)) & 0xff]++;
+        }
+    }
+
+    vector<uint64_t> keys_tmp(n);
+    vector<size_t> rows_tmp(n);
+    for (size_t d = 0; d < 8; d++) {
+        array<size_t, 256>& count = counts[d];
+        if (n == 0 || count[(keys[0] >> (8 * d)) & 0xff] == n) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t& c : count) {
+            size_t bucket = c;
+            c = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t pos = count[(keys[i] >> (8 * d)) & 0xff]++;
+            keys_tmp[pos] = keys[i];
+            rows_tmp[pos] = rows[i];
+        }
+        keys.swap(keys_tmp);
+        rows.swap(rows_tmp);
+    }
+}
+
+/**
+ * @brief A DataFrame's rows in the order of one or more sort keys, computed on demand.
+ *
+ * Returned by DataFrame::sort_values(). Nothing is sorted until the rows are needed:
+ * head() and tail() select only the first or last rows (a partial sort, O(n log k)),
+ * while print(), save_to_csv() and the conversion to a DataFrame compute the whole
+ * permutation once and gather every column with it. Like DataFrameView it refers to its
+ * parent, which must outlive it and not be modified while it is in use.
+ */
+class SortedView {
+public:
     /**
-     * @brief Prints the DataFrame with various formatting options.
-     * 
-     * @param rows_cnt Number of rows to print (0 = print all rows)
-     * @param is_tail If 1, prints from the end; if 0, prints from the beginning
-     * @param cols Vector of column names to print (empty = print all columns)
-     * @throws std::out_of_range If any specified column is not found
+     * @brief Describes a sort of the rows of a DataFrame.
+     *
+     * @param parent The DataFrame to sort
+     * @param keys Names of the key columns, most significant first
+     * @param ascending One direction per key, or a single one for all keys
+     * @throws std::out_of_range If a key column is not found
+     * @throws invalid_argument If keys is empty or ascending has the wrong size
+     */
+    SortedView(const DataFrame& parent, const vector<string>& keys, const vector<bool>& ascending)
+    : parent(&parent) {
+        if (keys.empty()) {
+            throw invalid_argument("Invalid argument: DataFrame::sort_values() expects at least one key column");
+        }
+        if (ascending.size() != 1 && ascending.size() != keys.size()) {
+            throw invalid_argument("Invalid argument: DataFrame::sort_values() expects one `ascending` flag or one per key");
+        }
+        for (size_t k = 0; k < keys.size(); k++) {
+            const Column* col = parent.find_column(keys[k]);
+            if (!col) {
+                throw std::out_of_range("Column not found!");
+            }
+            SortKey key;
+            key.col = col;
+            key.ascending = ascending.size() == 1 ? ascending[0] : ascending[k];
+            if (col->dtype == "int") {
+                key.kind = SortKey::int_key;
+            } else if (col->dtype == "float") {
+                key.kind = SortKey::float_key;
+            } else if (col->is_encoded()) {
+                // sort the dictionary once; rows are then ordered by the rank of their code
+                key.kind = SortKey::rank_key;
+                const vector<string>& dict = col->categories();
+                vector<uint32_t> by_value(dict.size());
+                for (uint32_t code = 0; code < by_value.size(); code++) {
+                    by_value[code] = code;
+                }
+                sort(by_value.begin(), by_value.end(), [&](uint32_t a, uint32_t b) {
+                    return dict[a] < dict[b];
+                });
+                key.ranks.resize(dict.size());
+                for (uint32_t rank = 0; rank < by_value.size(); rank++) {
+                    key.ranks[by_value[rank]] = rank;
+                }
+            } else {
+                key.kind = SortKey::str_key;
+            }
+            sort_keys.push_back(std::move(key));
+        }
+    }
+
+    size_t num_rows() const {
+        return parent->num_rows();
+    }
+
+    /**
+     * @brief Returns the parent's row indices in sorted order.
+     *
+     * Each key, least significant first, stably reorders the rows: numeric keys and
+     * dictionary-encoded strings with radix_sort(), plain strings with a merge sort whose
+     * runs are sorted and merged in parallel.
+     */
+    vector<size_t> row_indices() const {
+        LP_PROFILE_SCOPE("sort_values");
+        size_t n = num_rows();
+        LP_PROFILE_ROWS(n, 0);
+        vector<size_t> order(n);
+        for (size_t row = 0; row < n; row++) {
+            order[row] = row;
+        }
+        for (size_t k = sort_keys.size(); k-- > 0; ) {
+            if (sort_keys[k].kind == SortKey::str_key) {
+                sort_strings(sort_keys[k], order);
+            } else {
+                sort_numeric(sort_keys[k], order);
+            }
+        }
+        return order;
+    }
+
+    /**
+     * @brief Copies the rows into a new DataFrame in sorted order.
+     */
+    DataFrame to_frame() const {
+        return DataFrame(*this);
+    }
+
+    /**
+     * @brief Prints the rows in sorted order; see DataFrame::print().
      */
     void print(int rows_cnt = 0, int is_tail = 0, vector<string> cols = {}) const {
-        if (rows_cnt == 0) {
-            rows_cnt = row_data.size();
+        if (rows_cnt > 0) {
+            vector<size_t> rows = top_rows(static_cast<size_t>(rows_cnt), is_tail);
+            parent->print_rows(0, 0, cols, &rows);
+            return;
         }
+        vector<size_t> rows = row_indices();
+        parent->print_rows(0, 0, cols, &rows);
+    }
 
-        if (cols.size() == 0) {
-            cols = columns;
+    /**
+     * @brief Prints the first rows in sorted order, selected without sorting the others.
+     */
+    void head(int rows_cnt = 5) const {
+        print(rows_cnt);
+    }
+
+    /**
+     * @brief Prints the last rows in sorted order, selected without sorting the others.
+     */
+    void tail(int rows_cnt = 5) const {
+        print(rows_cnt, 1);
+    }
+
+    /**
+     * @brief Saves the rows to a CSV file in sorted order; see DataFrame::save_to_csv().
+     */
+    void save_to_csv(
+        const string& output_file,
+        bool index = true,
+        const string& sep = ",",
+        bool header = true,
+        const string& na_rep = "",
+        const vector <string>& selected_columns = {},
+        size_t num_threads = 0,
+        bool append = false
+    ) const {
+        vector<size_t> rows = row_indices();
+        parent->write_csv(output_file, index, sep, header, na_rep, selected_columns, &rows, num_threads, append);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const SortedView& view);
+
+private:
+    friend class DataFrame;
+
+    struct SortKey {
+        enum Kind { int_key, float_key, rank_key, str_key };
+
+        const Column* col;
+        bool ascending;
+        Kind kind;
+        vector<uint32_t> ranks; // rank of each dictionary code, for rank_key
+    };
+
+    const DataFrame* parent;
+    vector<SortKey> sort_keys;
+
+    static constexpr size_t run_rows = 1 << 16; // rows per run of the parallel merge sort
+
+    /**
+     * @brief Whether row has no value for key; NaN counts as missing. Missing values sort last.
+     */
+    static bool key_missing(const SortKey& key, size_t row) {
+        if (key.col->is_na(row)) {
+            return true;
+        }
+        if (key.kind == SortKey::float_key) {
+            double x = key.col->float_values()[row];
+            return x != x;
         }
+        return false;
+    }
 
-        vector<vector<string>> print_row_data;
-        vector<string> col_name_row;
-        size_t sz = 0;
-        for(string col : cols) {
-            bool found = false;
-            for (auto it = col_data.rbegin(); it != col_data.rend(); ++it) {
-                if (col == it->second.name) {
-                    col_name_row.push_back(it->second.name);
-                    sz = it->second.data.size();
-                    found = true;
-                    break;
+    /**
+     * @brief Compares rows a and b on all keys, in sort order; 0 if every key is equal.
+     */
+    int compare(size_t a, size_t b) const {
+        for (const SortKey& key : sort_keys) {
+            bool missing_a = key_missing(key, a);
+            bool missing_b = key_missing(key, b);
+            if (missing_a || missing_b) {
+                if (missing_a != missing_b) {
+                    return missing_a ? 1 : -1;
                 }
+                continue;
+            }
+            int cmp = 0;
+            if (key.kind == SortKey::int_key) {
+                int64_t x = key.col->int_values()[a];
+                int64_t y = key.col->int_values()[b];
+                cmp = x < y ? -1 : x > y ? 1 : 0;
+            } else if (key.kind == SortKey::float_key) {
+                double x = key.col->float_values()[a];
+                double y = key.col->float_values()[b];
+                cmp = x < y ? -1 : x > y ? 1 : 0;
+            } else if (key.kind == SortKey::rank_key) {
+                uint32_t x = key.ranks[key.col->codes()[a]];
+                uint32_t y = key.ranks[key.col->codes()[b]];
+                cmp = x < y ? -1 : x > y ? 1 : 0;
+            } else {
+                cmp = key.col->str_at(a).compare(key.col->str_at(b));
+                cmp = cmp < 0 ? -1 : cmp > 0 ? 1 : 0;
+            }
+            if (cmp != 0) {
+                return key.ascending ? cmp : -cmp;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Returns the first (or last) min(count, num_rows()) rows of the sorted order.
+     */
+    vector<size_t> top_rows(size_t count, bool from_end) const {
+        size_t n = num_rows();
+        count = std::min(count, n);
+        vector<size_t> rows(n);
+        for (size_t row = 0; row < n; row++) {
+            rows[row] = row;
+        }
+        // ties are broken by row index, as in the stable full sort
+        if (from_end) {
+            partial_sort(rows.begin(), rows.begin() + count, rows.end(), [&](size_t a, size_t b) {
+                int cmp = compare(a, b);
+                return cmp > 0 || (cmp == 0 && a > b);
+            });
+            rows.resize(count);
+            reverse(rows.begin(), rows.end());
+        } else {
+            partial_sort(rows.begin(), rows.begin() + count, rows.end(), [&](size_t a, size_t b) {
+                int cmp = compare(a, b);
+                return cmp < 0 || (cmp == 0 && a < b);
+            });
+            rows.resize(count);
+        }
+        return rows;
+    }
+
+    /**
+     * @brief Stably reorders rows by an int, float or dictionary-encoded key.
+     *
+     * The values are mapped to unsigned words in the same order (flipping the sign bit of
+     * ints and all bits of negative floats; complemented for descending keys) and radix
+     * sorted. Missing values keep their order at the end.
+     */
+    static void sort_numeric(const SortKey& key, vector<size_t>& order) {
+        vector<uint64_t> words;
+        vector<size_t> present;
+        vector<size_t> missing;
+        words.reserve(order.size());
+        present.reserve(order.size());
+        for (size_t row : order) {
+            if (key_missing(key, row)) {
+                missing.push_back(row);
+                continue;
             }
-
-            if (!found) {
-                throw std::out_of_range("Column not found!");
+            uint64_t word;
+            if (key.kind == SortKey::int_key) {
+                word = static_cast<uint64_t>(key.col->int_values()[row]) ^ (uint64_t(1) << 63);
+            } else if (key.kind == SortKey::float_key) {
+                double x = key.col->float_values()[row];
+                x = x == 0 ? 0.0 : x; // -0.0 and 0.0 are equal
+                memcpy(&word, &x, sizeof(word));
+                word = word >> 63 ? ~word : word | (uint64_t(1) << 63);
+            } else {
+                word = key.ranks[key.col->codes()[row]];
             }
+            words.push_back(key.ascending ? word : ~word);
+            present.push_back(row);
         }
-        print_row_data.push_back(col_name_row);
+        radix_sort(words, present);
+        present.insert(present.end(), missing.begin(), missing.end());
+        order.swap(present);
+    }
 
-        for(size_t idx = 0; idx < sz; idx++) {
-            vector<string> new_row;
-            for(string col : cols) {
-                for (auto it = col_data.rbegin(); it != col_data.rend(); ++it) {
-                    if (col == it->second.name) {
-                        new_row.push_back(it->second.data[idx]);
-                        break;
-                    }
-                }
+    /**
+     * @brief Stably reorders rows by a plain string key with a parallel merge sort.
+     *
+     * Fixed runs of run_rows rows are sorted independently, then adjacent runs are merged
+     * in rounds; the runs do not depend on the thread count, and neither does the result.
+     * Missing values keep their order at the end.
+     */
+    static void sort_strings(const SortKey& key, vector<size_t>& order) {
+        vector<pair<string_view, size_t>> items;
+        vector<size_t> missing;
+        items.reserve(order.size());
+        for (size_t row : order) {
+            if (key_missing(key, row)) {
+                missing.push_back(row);
+            } else {
+                items.emplace_back(key.col->str_at(row), row);
             }
-            print_row_data.push_back(new_row);
         }
+        auto before = [&](const pair<string_view, size_t>& a, const pair<string_view, size_t>& b) {
+            return key.ascending ? a.first < b.first : b.first < a.first;
+        };
 
-        size_t idx = 0;
-        for(auto& row : print_row_data) {
-            cout << std::left;
-            if (is_tail && idx < static_cast<size_t>(row_data.size()-rows_cnt)) {
-                if (idx == 0) {
-                    for(auto& element : row) {
-                        cout << setw(20) << element;
-                    }
-                    cout << endl;
-                }
-                idx++;
-                continue;
-            }
-            for(auto& element : row) {
-                cout << setw(20) << element;
-            }
-            cout << endl;
-            idx++;
-            if (idx == static_cast<size_t>(rows_cnt + 1) && !is_tail) {
-                break;
-            }
+        size_t n = items.size();
+        size_t threads = n >= parallel_min_rows ? 0 : 1;
+        size_t num_runs = (n + run_rows - 1) / run_rows;
+        parallel_for(num_runs, threads, [&](size_t run) {
+            stable_sort(items.begin() + run * run_rows, items.begin() + std::min(n, (run + 1) * run_rows), before);
+        });
+        vector<pair<string_view, size_t>> merged(n);
+        for (size_t width = run_rows; width < n; width *= 2) {
+            parallel_for((n + 2 * width - 1) / (2 * width), threads, [&](size_t pair_idx) {
+                size_t begin = pair_idx * 2 * width;
+                size_t mid = std::min(n, begin + width);
+                size_t end = std::min(n, begin + 2 * width);
+                std::merge(items.begin() + begin, items.begin() + mid, items.begin() + mid, items.begin() + end,
+                           merged.begin() + begin, before);
+            });
+            items.swap(merged);
+        }
 
-            if (idx == row_data.size() && is_tail) {
-                break;
-            }
+        order.clear();
+        for (const auto& item : items) {
+            order.push_back(item.second);
         }
-        cout << "\nPrinted: " << print_row_data.size() << " rows\n";
+        order.insert(order.end(), missing.begin(), missing.end());
     }
+};
+
+inline SortedView DataFrame::sort_values(const vector<string>& keys, const vector<bool>& ascending) const {
+    return SortedView(*this, keys, ascending);
+}
+
+inline DataFrame::DataFrame(const SortedView& view)
+: file_dir(view.parent->file_dir),
+  columns(view.parent->columns) {
+    vector<size_t> order = view.row_indices();
+    LP_PROFILE_SCOPE("sort.gather");
+    LP_PROFILE_ROWS(order.size(), 0);
+    const vector<Column>& source = view.parent->col_data;
+    col_data.resize(source.size());
+    parallel_for(source.size(), order.size() >= parallel_min_rows ? 0 : 1, [&](size_t c) {
+        col_data[c] = source[c].take(order);
+    });
+    index_columns();
+    LP_PROFILE_MEMORY(memory_bytes());
+}
 
+/**
+ * @brief A query over a DataFrame or a file, recorded as a plan and run by collect().
+ *
+ * Returned by DataFrame::lazy(), DataFrame::scan_csv() and DataFrame::scan_binary(). Each
+ * step returns a new LazyFrame and nothing is read until collect(), which
+ * - reads only the columns the query uses: the CSV reader never parses the others and
+ *   the binary reader never copies them;
+ * - pushes filters down into the source: CSV chunks drop non-matching rows right after
+ *   they are parsed, the binary reader copies the other columns only at matching rows,
+ *   and a DataFrame source is gathered once;
+ * - runs the remaining element-wise steps (fillna, filters on filled columns, select,
+ *   rename) as one pass that gathers each output column once.
+ *
+ * A frame returned by DataFrame::lazy() refers to that DataFrame, which must outlive it.
+ */
+class LazyFrame {
+public:
     /**
-     * @brief Displays the first N rows of the DataFrame.
-     * 
-     * @param rows_cnt Number of rows to display from the beginning (default: 5)
+     * @brief Keeps the rows matching predicate, e.g. `Expr::col("Years") > 30`.
      */
-    void head(int rows_cnt = 5) const {
-        print(rows_cnt);
-    };
+    LazyFrame filter(const Expr& predicate) const {
+        Step step;
+        step.kind = Step::filter;
+        step.predicate = predicate;
+        return with(std::move(step));
+    }
 
     /**
-     * @brief Displays the last N rows of the DataFrame.
-     * 
-     * @param rows_cnt Number of rows to display from the end (default: 5)
+     * @brief Keeps the given columns, in this order.
      */
-    void tail(int rows_cnt = 5) const {
-        print(rows_cnt, 1);
-    };
+    LazyFrame select(const vector<string>& cols) const {
+        Step step;
+        step.kind = Step::select;
+        step.names = cols;
+        return with(std::move(step));
+    }
 
     /**
-     * @brief Renames columns in the DataFrame.
-     * 
-     * @param vec Vector of pairs containing (old_name, new_name) mappings
-     * @throws std::out_of_range If any old column name is not found
+     * @brief Renames columns; see DataFrame::rename().
      */
-    void rename(vector<pair<string, string>> vec) {
-        for(pair<string, string> col_pair : vec) {
-            string old_col_name = col_pair.first;
-            string new_col_name = col_pair.second;
-
-            auto it = col_data.find(old_col_name);
-            if (it != col_data.end()) {
-                col_data[new_col_name] = it->second;
-                col_data[new_col_name].name = new_col_name;
-                col_data[new_col_name].dtype = col_data[new_col_name].dtype;
-                col_data.erase(old_col_name);
-
-                for(string &col : columns) {
-                    if (col == old_col_name) {
-                        col = new_col_name;
-                    }
-                }
-                continue;
-            }
-
-            throw std::out_of_range("Column not found!");
-        }
+    LazyFrame rename(const vector<pair<string, string>>& names) const {
+        Step step;
+        step.kind = Step::rename;
+        step.pairs = names;
+        return with(std::move(step));
     }
 
     /**
-     * @brief Fills all missing values in the DataFrame with a specified value.
-     * 
-     * @tparam T The type of the fill value (int, double, or string)
-     * @param x The value to use for filling missing entries
-     * @note Applies to all columns in the DataFrame
+     * @brief Fills missing values; see DataFrame::fillna().
      */
     template <typename T>
-    void fillna(T x) {
-        for (auto it = col_data.begin(); it != col_data.end(); ++it) {
-            for(string &element : it->second.data) {
-                if (element.length() == 0) {
-                    if (is_same<T, int>::value || is_same<T, double>::value) {
-                        element = to_string(x);
-                    } else {
-                        element = x;
-                    }
+    LazyFrame fillna(const T& x) const {
+        Step step;
+        step.kind = Step::fillna;
+        if constexpr (is_arithmetic_v<T>) {
+            step.fill = [x](Column& col) {
+                col.fillna(x);
+            };
+        } else {
+            step.fill = [value = string(x)](Column& col) {
+                if (col.dtype == "string") {
+                    col.fillna(value);
                 }
-            }
+            };
         }
+        return with(std::move(step));
     }
 
     /**
-     * @brief Removes rows from the DataFrame where the specified column has missing values.
-     * 
-     * @param col The name of the column to check for missing values
-     * @note Removes entire rows across all columns when the specified column has empty values
+     * @brief Sets the key columns of the next agg().
+     */
+    LazyFrame groupby(const vector<string>& keys) const {
+        LazyFrame result = *this;
+        result.group_keys = keys;
+        return result;
+    }
+
+    /**
+     * @brief Aggregates columns, within each group if groupby() was called first; see GroupBy::agg().
+     *
+     * Without groupby() the result has a single row, aggregating every row.
      */
-    void dropna(string col) {
-        vector<string> &data = col_data[col].data;
-        vector<int> removed_idx;
+    LazyFrame agg(const vector<pair<string, string>>& aggs) const {
+        Step step;
+        step.kind = Step::agg;
+        step.names = group_keys;
+        step.pairs = aggs;
+        LazyFrame result = with(std::move(step));
+        result.group_keys.clear();
+        return result;
+    }
 
-        for(size_t idx = 0; idx < data.size(); idx++) {
-            if (data[idx].length() == 0) {
-                removed_idx.push_back(idx);
-            }
-        }
+    /**
+     * @brief Runs the query.
+     *
+     * @return The resulting DataFrame
+     * @throws std::out_of_range If a step refers to a column that does not exist at that point
+     * @throws invalid_argument If a rename clashes with an existing column or an aggregate is invalid
+     * @throws runtime_error If a file cannot be read (see DataFrame's readers)
+     */
+    DataFrame collect() const;
 
-        int jdx = 0;
-        for(size_t idx : removed_idx) {
-            for (auto it = col_data.begin(); it != col_data.end(); ++it) {
-                it->second.data.erase(it->second.data.begin() + idx - jdx);
-            }
-            jdx++;
+private:
+    friend class DataFrame;
+
+    enum class Source { frame, csv, binary };
+
+    struct Step {
+        enum Kind { filter, select, rename, fillna, agg };
+
+        Kind kind;
+        optional<Expr> predicate; // filter
+        vector<string> names; // select: columns, agg: keys
+        vector<pair<string, string>> pairs; // rename: (old, new), agg: (column, function)
+        function<void(Column&)> fill; // fillna
+    };
+
+    Source source;
+    shared_ptr<const DataFrame> frame;
+    string path;
+    CsvOptions options;
+    vector<Step> steps;
+    vector<string> group_keys; // set by groupby(), used by the next agg()
+
+    LazyFrame(Source source, shared_ptr<const DataFrame> frame, string path, CsvOptions options = CsvOptions())
+    : source(source), frame(std::move(frame)), path(std::move(path)), options(std::move(options)) {}
+
+    LazyFrame with(Step step) const {
+        LazyFrame result = *this;
+        result.steps.push_back(std::move(step));
+        return result;
+    }
+
+    static const Column& column_of(const DataFrame& df, const string& name) {
+        const Column* col = df.find_column(name);
+        if (!col) {
+            throw std::out_of_range("Column not found!");
         }
+        return *col;
     }
 
     /**
-     * @brief Saves the DataFrame to a CSV file with customizable options.
-     *
-     * This function allows saving the DataFrame to a specified file with various options:
-     * - Custom separator for columns.
-     * - Option to include or exclude column headers.
-     * - Option to include or exclude row indices.
-     * - Replace missing values with a custom string.
-     * - Save only specific columns if specified.
-     *
-     * @param output_file The path to the output file where the DataFrame will be saved.
-     * @param index Whether to include row indices in the output file (default: true).
-     * @param sep The separator to use between columns (default: ",").
-     * @param header Whether to include column headers in the output file (default: true).
-     * @param na_rep The string to replace missing values (default: "").
-     * @param selected_columns A vector of column names to save. If empty, all columns are saved (default: {}).
-     * @throws std::runtime_error If the file cannot be opened for writing.
-     * @throws std::out_of_range If any of the specified columns in `selected_columns` do not exist.
+     * @brief Returns the names of the source's columns without reading any data.
      */
-    void save_to_csv(
-        const string& output_file,
-        bool index = true,
-        const string& sep = ",",
-        bool header = true,
-        const string& na_rep = "",
-        const vector <string>& selected_columns = {}
-    ) const {
-        std::filesystem::path file_path(output_file);
- 
-        // Create directories if they don't exist
-        if (!file_path.parent_path().empty()) {
-           std::filesystem::create_directories(file_path.parent_path());
+    vector<string> source_columns() const {
+        if (source == Source::frame) {
+            return frame->columns;
         }
-        ofstream file(output_file);
- 
-        if (!file) {
-           throw runtime_error("Error: Unable to open file for writing!");
+        if (source == Source::csv) {
+            return CsvReader(path, options).header();
         }
- 
-        // Determine which columns to save
-        vector < string > columns_to_save;
-        if (selected_columns.empty()) {
-           columns_to_save = columns;
-        } else {
-           // Validate selected columns
-           for (const string & col_name: selected_columns) {
-              if (col_data.find(col_name) == col_data.end()) {
-                 throw std::out_of_range("Column not found: " + col_name);
-              }
-              columns_to_save.push_back(col_name);
-           }
+        vector<BinaryColumnEntry> entries;
+        vector<string> names;
+        DataFrame::read_binary_directory(MappedFile(path), entries, names);
+        return names;
+    }
+
+    /**
+     * @brief Reads the given source columns at the rows matching filter (all rows if null).
+     */
+    DataFrame scan(const vector<string>& needed, const Expr* filter) const {
+        DataFrame df;
+        if (needed.empty()) {
+            return df;
         }
- 
-        // handle header option
-        if (header) {
-           // index option
-           if (index) {
-              file << "index" << sep;
-           }
-           for (size_t i = 0; i < columns_to_save.size(); ++i) {
-              file << columns_to_save[i];
-              if (i < columns_to_save.size() - 1) {
-                 file << sep;
-              }
-           }
-           file << endl;
+        if (source == Source::binary) {
+            return DataFrame::read_binary_where(path, needed, filter);
         }
- 
-        // Determine the number of rows
-        size_t num_rows = 0;
-        if (!columns_to_save.empty()) {
-           const string & first_col = columns_to_save[0];
-           num_rows = col_data.at(first_col).data.size();
-         }
- 
-        // Write row data
-        for (size_t idx = 0; idx < num_rows; ++idx) {
-           if (index) {
-              file << idx << sep;
-           }
- 
-           for (size_t j = 0; j < columns_to_save.size(); ++j) {
-              const string & col_name = columns_to_save[j];
-              const auto & col = col_data.at(col_name);
- 
-              // Replace missing values with `na_rep` string
-              string value = col.data[idx].empty() ? na_rep : col.data[idx];
-              file << value;
- 
-              if (j < columns_to_save.size() - 1) {
-                 file << sep;
-              }
-           }
-           file << endl;
+        if (source == Source::csv) {
+            CsvOptions scan_options = options;
+            scan_options.usecols = needed;
+            df.file_dir = path;
+            CsvReader(path, scan_options).read(df.columns, df.col_data, filter);
+            df.index_columns();
+            return df;
         }
- 
-        file.close();
-        cout << "Data saved successfully to " << output_file << " with separator '" << sep << "'." << endl;
-     }
 
-    friend std::ostream& operator<<(std::ostream& os, const DataFrame& df);
+        vector<size_t> rows;
+        if (filter) {
+            rows = filter->evaluate([&](const string& name) -> const Column& {
+                return column_of(*frame, name);
+            }).indices();
+        }
+        df.file_dir = frame->file_dir;
+        for (const string& name : needed) {
+            const Column& col = column_of(*frame, name);
+            df.columns.push_back(name);
+            df.col_data.push_back(filter ? col.take(rows) : col);
+        }
+        df.index_columns();
+        return df;
+    }
 
     /**
-     * @brief Filters the DataFrame using a boolean mask.
-     * 
-     * @param mask Vector of boolean values indicating which rows to include
-     * @return Reference to a new filtered DataFrame
-     * @throws std::out_of_range If the mask size doesn't match the number of data rows
-     * @note Creates a new DataFrame with only the rows where mask is true
-     * @note The header row is always preserved
+     * @brief Aggregates every row of df into a single row; see GroupBy::agg().
      */
-    DataFrame& operator[](const vector<bool> & mask) {
-        size_t data_rows = row_data.size() - 1; // Exclude header
-        if (mask.size() != data_rows) {
-            throw std::out_of_range("Mask size does not match data rows!");
+    static DataFrame aggregate_all(const DataFrame& df, const vector<pair<string, string>>& aggs) {
+        DataFrame result;
+        for (const auto& [col_name, func] : aggs) {
+            const Column& col = column_of(df, col_name);
+            if (func != "sum" && func != "mean" && func != "min" && func != "max" && func != "count") {
+                throw invalid_argument("Invalid argument: LazyFrame::agg() expects sum, mean, min, max or count, got " + func);
+            }
+            if (func != "count" && col.dtype == "string") {
+                throw invalid_argument("Invalid type: LazyFrame::agg() expects `dtype` to be int or float for " + func);
+            }
+            Column out;
+            out.name = col_name + "_" + func;
+            bool keep_dtype = func == "min" || func == "max" || func == "sum";
+            out.dtype = func == "count" ? "int" : keep_dtype ? col.dtype : "float";
+            if (func == "count") {
+                out.append(static_cast<int64_t>(col.count()));
+            } else if (col.dtype == "int" && func == "sum") {
+                // exact in int64, wrapping around on overflow like GroupBy::agg()
+                uint64_t total = col.as<int64_t>().reduce(uint64_t(0), [](uint64_t acc, int64_t x) {
+                    return acc + static_cast<uint64_t>(x);
+                });
+                out.append(static_cast<int64_t>(total));
+            } else if (col.dtype == "int" && keep_dtype && col.count() > 0) {
+                bool is_min = func == "min";
+                out.append(col.as<int64_t>().reduce(is_min ? numeric_limits<int64_t>::max() : numeric_limits<int64_t>::min(),
+                                                    [is_min](int64_t acc, int64_t x) {
+                    return is_min ? std::min(acc, x) : std::max(acc, x);
+                }));
+            } else if (func == "sum") {
+                out.append(col.sum());
+            } else if (col.count() == 0) {
+                out.append_na();
+            } else {
+                out.append(func == "mean" ? col.mean() : func == "min" ? col.min() : col.max());
+            }
+            result.columns.push_back(out.name);
+            result.col_data.push_back(std::move(out));
         }
+        result.index_columns();
+        return result;
+    }
+};
+
+inline LazyFrame DataFrame::lazy() const {
+    // refers to this DataFrame without owning it
+    return LazyFrame(LazyFrame::Source::frame, shared_ptr<const DataFrame>(this, [](const DataFrame*) {}), "");
+}
 
-        DataFrame *filtered_df = new DataFrame(*this);
+inline LazyFrame DataFrame::scan_csv(const string& path, const CsvOptions& options) {
+    return LazyFrame(LazyFrame::Source::csv, nullptr, path, options);
+}
+
+inline LazyFrame DataFrame::scan_binary(const string& path) {
+    return LazyFrame(LazyFrame::Source::binary, nullptr, path);
+}
 
-        // Preserve the header row
-        filtered_df->row_data.push_back(row_data[0]);
+inline DataFrame LazyFrame::collect() const {
+    LP_PROFILE_SCOPE("collect");
+    // the steps up to the first aggregation run against the source, the rest on its result
+    size_t end = 0;
+    while (end < steps.size() && steps[end].kind != Step::agg) {
+        end++;
+    }
 
-        // Filter data rows 
-        for (size_t i = 0; i < data_rows; ++i) {
-            if (mask[i]) {
-                filtered_df->row_data.push_back(row_data[i + 1]); // Skip header
+    // follow the columns through select and rename as (output name, source column) pairs
+    vector<string> schema = source_columns();
+    vector<pair<string, string>> cols;
+    for (const string& name : schema) {
+        cols.emplace_back(name, name);
+    }
+    auto source_of = [&](const string& name) {
+        for (const auto& col : cols) {
+            if (col.first == name) {
+                return col.second;
             }
         }
+        throw std::out_of_range("Column not found!");
+    };
+    auto on_source = [&](const Expr& predicate) {
+        map<string, string> names;
+        for (const string& name : predicate.columns()) {
+            names[name] = source_of(name);
+        }
+        return predicate.renamed(names);
+    };
 
-        // Rebuild columns from filtered data
-        for (const auto& col_name : columns) {
-            Column filtered_col;
-            filtered_col.name = col_name;
-            filtered_col.dtype = col_data.at(col_name).dtype;
-
-            // Copy data based on mask (original data indices)
-            for (size_t i = 0; i < data_rows; ++i) {
-                if (mask[i]) {
-                    filtered_col.data.push_back(col_data.at(col_name).data[i]);
+    // filters that only read untouched source columns go to the reader; fillna and the
+    // filters reading filled columns run afterwards, in order
+    struct LateStep {
+        const Step* fill = nullptr;
+        vector<string> targets; // source columns the fill applies to
+        optional<Expr> predicate;
+    };
+    optional<Expr> pushed;
+    vector<LateStep> late;
+    vector<string> filled;
+    for (size_t idx = 0; idx < end; idx++) {
+        const Step& step = steps[idx];
+        if (step.kind == Step::filter) {
+            Expr predicate = on_source(*step.predicate);
+            bool touched = false;
+            for (const string& name : predicate.columns()) {
+                touched |= find(filled.begin(), filled.end(), name) != filled.end();
+            }
+            if (touched) {
+                LateStep late_filter;
+                late_filter.predicate = predicate;
+                late.push_back(std::move(late_filter));
+            } else {
+                pushed = pushed ? *pushed & predicate : predicate;
+            }
+        } else if (step.kind == Step::select) {
+            vector<pair<string, string>> selected;
+            for (const string& name : step.names) {
+                selected.emplace_back(name, source_of(name));
+            }
+            cols = std::move(selected);
+        } else if (step.kind == Step::rename) {
+            for (const auto& [old_name, new_name] : step.pairs) {
+                auto it = find_if(cols.begin(), cols.end(), [&](const auto& col) {
+                    return col.first == old_name;
+                });
+                if (it == cols.end()) {
+                    throw std::out_of_range("Column not found!");
+                }
+                if (new_name != old_name && find_if(cols.begin(), cols.end(), [&](const auto& col) {
+                        return col.first == new_name;
+                    }) != cols.end()) {
+                    throw invalid_argument("Column already exists: " + new_name);
                 }
+                it->first = new_name;
             }
-            filtered_df->col_data[col_name] = filtered_col;
+        } else {
+            LateStep fill;
+            fill.fill = &step;
+            for (const auto& col : cols) {
+                fill.targets.push_back(col.second);
+                filled.push_back(col.second);
+            }
+            late.push_back(std::move(fill));
         }
-
-        return *filtered_df;
+    }
+    if (end < steps.size()) {
+        // the aggregation only reads its keys and values
+        vector<pair<string, string>> used;
+        auto use = [&](const string& name) {
+            for (const auto& col : used) {
+                if (col.first == name) {
+                    return;
+                }
+            }
+            used.emplace_back(name, source_of(name));
+        };
+        for (const string& key : steps[end].names) {
+            use(key);
+        }
+        for (const auto& agg : steps[end].pairs) {
+            use(agg.first);
+        }
+        cols = std::move(used);
     }
 
-    /**
-     * @brief Accesses a single column by name.
-     * 
-     * @param key The name of the column to access
-     * @return Reference to the Column object
-     * @throws std::out_of_range If the column name is not found
-     */
-    Column& operator[](const string& key) {
-        auto it = col_data.find(key);
-        if (it != col_data.end()) {
-            return it->second;
+    // read only the source columns some step uses, in source order
+    vector<string> used_names;
+    for (const auto& col : cols) {
+        used_names.push_back(col.second);
+    }
+    for (const LateStep& step : late) {
+        if (step.predicate) {
+            vector<string> names = step.predicate->columns();
+            used_names.insert(used_names.end(), names.begin(), names.end());
+        }
+    }
+    vector<string> needed;
+    for (const string& name : schema) {
+        if (find(used_names.begin(), used_names.end(), name) != used_names.end()) {
+            needed.push_back(name);
         }
-        throw std::out_of_range("Column not found!");
     }
+    if (pushed && source == Source::csv) {
+        // the CSV reader tests rows on the columns it parsed; the other sources read the
+        // filter's columns on their own
+        for (const string& name : pushed->columns()) {
+            if (find(needed.begin(), needed.end(), name) == needed.end()) {
+                needed.push_back(name);
+            }
+        }
+    }
+    DataFrame scanned = scan(needed, pushed ? &*pushed : nullptr);
 
-    /**
-     * @brief Displays specific columns of the DataFrame.
-     * 
-     * @param keys Vector of column names to display
-     * @return A dummy Column object (for interface compatibility)
-     * @note This method prints the specified columns and returns a dummy Column
-     */
-    Column operator[](const vector<string>& keys) {
-        print(0, 0, keys);
+    // fill in place and combine the late filters into one mask
+    optional<Bitmap> mask;
+    for (const LateStep& step : late) {
+        if (step.fill) {
+            for (const string& name : step.targets) {
+                auto it = scanned.col_index.find(name);
+                if (it != scanned.col_index.end()) {
+                    step.fill->fill(scanned.col_data[it->second]);
+                }
+            }
+            continue;
+        }
+        Bitmap matched = step.predicate->evaluate([&](const string& name) -> const Column& {
+            return scanned[name];
+        });
+        mask = mask ? *mask & matched : matched;
+    }
 
-        Column dummy;
-        return dummy;
+    // gather each output column once
+    vector<size_t> rows;
+    if (mask) {
+        rows = mask->indices();
+    }
+    DataFrame result;
+    result.file_dir = scanned.file_dir;
+    for (const auto& [out_name, src_name] : cols) {
+        size_t uses = count_if(cols.begin(), cols.end(), [&](const auto& col) {
+            return col.second == src_name;
+        });
+        Column& col = scanned.col_data[scanned.col_index.at(src_name)];
+        Column gathered = mask ? col.take(rows) : uses == 1 ? std::move(col) : col;
+        gathered.name = out_name;
+        result.columns.push_back(out_name);
+        result.col_data.push_back(std::move(gathered));
+    }
+    result.index_columns();
+    if (end == steps.size()) {
+        return result;
     }
-};
+
+    const Step& step = steps[end];
+    DataFrame aggregated = step.names.empty() ? aggregate_all(result, step.pairs) : result.groupby(step.names).agg(step.pairs);
+    LazyFrame rest(Source::frame, make_shared<const DataFrame>(std::move(aggregated)), "");
+    rest.steps.assign(steps.begin() + end + 1, steps.end());
+    return rest.collect();
+}
 
 ostream& operator<<(std::ostream& os, const DataFrame& df) {
     df.print();
     return os;
 }
 
+inline ostream& operator<<(std::ostream& os, const DataFrameView& view) {
+    view.print();
+    return os;
+}
+
+inline ostream& operator<<(std::ostream& os, const SortedView& view) {
+    view.print();
+    return os;
+}
+
 ostream& operator<<(std::ostream& os, const Column& col) {
     col.print();
     return os;